@@ -79,12 +79,14 @@ C64::C64()
     initialize();
     _reset();
     
-    // Initialize mach timer info
-    mach_timebase_info(&timebase);
+    // Clear the frame pacing statistics
+    clearTimingInfo();
+    clearProfileInfo();
     
     // Initialize mutexes
     pthread_mutex_init(&threadLock, NULL);
     pthread_mutex_init(&stateChangeLock, NULL);
+    pthread_mutex_init(&inspectionLock, NULL);
 }
 
 C64::~C64()
@@ -92,8 +94,11 @@ C64::~C64()
     debug(RUN_DEBUG, "Destroying C64[%p]\n", this);
     powerOff();
     
+    delete [] runAheadState;
+    
     pthread_mutex_destroy(&threadLock);
     pthread_mutex_destroy(&stateChangeLock);
+    pthread_mutex_destroy(&inspectionLock);
 }
 
 void
@@ -130,6 +135,19 @@ C64::_reset()
     
     rasterCycle = 1;
     nanoTargetTime = 0UL;
+    
+    // Schedule the initial events
+    rescheduleEvents();
+    updateRunLoopFunctions();
+}
+
+size_t
+C64::didLoadFromBuffer(u8 *buffer)
+{
+    // Schedule events according to the restored component states
+    rescheduleEvents();
+    updateRunLoopFunctions();
+    return 0;
 }
 
 void
@@ -192,6 +210,9 @@ C64::getConfigItem(ConfigOption option)
         case OPT_CUT_OPACITY:
         case OPT_SS_COLLISIONS:
         case OPT_SB_COLLISIONS:
+        case OPT_INDEXED_TEXTURE:
+        case OPT_FRAME_SKIP:
+        case OPT_VIC_HEADLESS:
             return vic.getConfigItem(option);
                         
         case OPT_CIA_REVISION:
@@ -227,6 +248,7 @@ C64::getConfigItem(DriveID id, ConfigOption option)
         case OPT_DRIVE_TYPE:
         case OPT_DRIVE_CONNECT:
         case OPT_DRIVE_POWER_SWITCH:
+        case OPT_DRIVE_FAST_CPU:
             return drive.getConfigItem(option);
             
         default:
@@ -521,6 +543,78 @@ C64::updateVicFunctionTable()
     }
 }
 
+void
+C64::updateRunLoopFunctions()
+{
+    bool drv8 = drive8.isActive();
+    bool drv9 = drive9.isActive();
+    bool tape = datasette.getPlayKey();
+    bool dbg = cpu.inDebugMode();
+    
+    debug(RUN_DEBUG, "updateRunLoopFunctions (%d %d %d %d)\n", drv8, drv9, tape, dbg);
+    
+    // Table index: Bit 0 = Drive 8, Bit 1 = Drive 9, Bit 2 = Tape, Bit 3 = Debug
+    static void (C64::*lineFuncs[16])(void) = {
+        
+        &C64::_executeOneLine<false, false, false, false>,
+        &C64::_executeOneLine<true,  false, false, false>,
+        &C64::_executeOneLine<false, true,  false, false>,
+        &C64::_executeOneLine<true,  true,  false, false>,
+        &C64::_executeOneLine<false, false, true,  false>,
+        &C64::_executeOneLine<true,  false, true,  false>,
+        &C64::_executeOneLine<false, true,  true,  false>,
+        &C64::_executeOneLine<true,  true,  true,  false>,
+        &C64::_executeOneLine<false, false, false, true>,
+        &C64::_executeOneLine<true,  false, false, true>,
+        &C64::_executeOneLine<false, true,  false, true>,
+        &C64::_executeOneLine<true,  true,  false, true>,
+        &C64::_executeOneLine<false, false, true,  true>,
+        &C64::_executeOneLine<true,  false, true,  true>,
+        &C64::_executeOneLine<false, true,  true,  true>,
+        &C64::_executeOneLine<true,  true,  true,  true>
+    };
+    static void (C64::*cycleFuncs[16])(void) = {
+        
+        &C64::_executeOneCycle<false, false, false, false>,
+        &C64::_executeOneCycle<true,  false, false, false>,
+        &C64::_executeOneCycle<false, true,  false, false>,
+        &C64::_executeOneCycle<true,  true,  false, false>,
+        &C64::_executeOneCycle<false, false, true,  false>,
+        &C64::_executeOneCycle<true,  false, true,  false>,
+        &C64::_executeOneCycle<false, true,  true,  false>,
+        &C64::_executeOneCycle<true,  true,  true,  false>,
+        &C64::_executeOneCycle<false, false, false, true>,
+        &C64::_executeOneCycle<true,  false, false, true>,
+        &C64::_executeOneCycle<false, true,  false, true>,
+        &C64::_executeOneCycle<true,  true,  false, true>,
+        &C64::_executeOneCycle<false, false, true,  true>,
+        &C64::_executeOneCycle<true,  false, true,  true>,
+        &C64::_executeOneCycle<false, true,  true,  true>,
+        &C64::_executeOneCycle<true,  true,  true,  true>
+    };
+    
+    unsigned index = (drv8 ? 1 : 0) | (drv9 ? 2 : 0) | (tape ? 4 : 0) | (dbg ? 8 : 0);
+    lineFunc = lineFuncs[index];
+    cycleFunc = cycleFuncs[index];
+    
+    // Route memory accesses through the slow path while watchpoints are set
+    bool watch = cpu.debugger.watchpoints.elements() != 0;
+    if (mem.checkWatchpoints != watch) {
+        mem.checkWatchpoints = watch;
+        mem.updatePageTable();
+    }
+}
+
+void
+C64::requestRunLoopUpdate()
+{
+    if (isRunning()) {
+        signalFunctionUpdate();
+    } else {
+        updateRunLoopFunctions();
+    }
+}
+
 void
 C64::setWarp(bool enable)
 {
@@ -638,6 +732,61 @@ C64::inspect()
     }
 }
 
+bool
+C64::getInspection(InspectionInfo &result)
+{
+    pthread_mutex_lock(&inspectionLock);
+    bool updated = inspections.update();
+    result = inspections.front();
+    pthread_mutex_unlock(&inspectionLock);
+    
+    return updated;
+}
+
+void
+C64::publishInspection()
+{
+    if (inspectionTarget == INSPECT_NONE) return;
+    
+    InspectionInfo &info = inspections.back();
+    info.frame = frame;
+    info.target = inspectionTarget;
+    
+    // getInfo() inspects components by itself if the emulator isn't running
+    if (isRunning()) inspect();
+    
+    switch(inspectionTarget) {
+            
+        case INSPECT_CPU:
+            info.cpu = cpu.getInfo();
+            break;
+            
+        case INSPECT_MEM:
+            info.mem = mem.getInfo();
+            break;
+            
+        case INSPECT_CIA:
+            info.cia[0] = cia1.getInfo();
+            info.cia[1] = cia2.getInfo();
+            break;
+            
+        case INSPECT_VIC:
+            info.vic = vic.getInfo();
+            for (int i = 0; i < 8; i++) info.sprite[i] = vic.getSpriteInfo(i);
+            break;
+            
+        case INSPECT_SID:
+            info.sid = sid.getInfo();
+            for (int i = 0; i < 3; i++) info.voice[i] = sid.getVoiceInfo(i);
+            break;
+            
+        default:
+            break;
+    }
+    
+    inspections.publish();
+}
+
 void
 C64::_pause()
 {
@@ -646,6 +795,12 @@ C64::_pause()
     // When we reach this line, the emulator thread is already gone
     assert(p == NULL);
     
+    // Apply a pending run loop update the thread didn't get to anymore
+    if (runLoopCtrl & RL_UPDATE_FUNCTIONS) {
+        updateRunLoopFunctions();
+        clearControlFlags(RL_UPDATE_FUNCTIONS);
+    }
+    
     // Update the recorded debug information
     inspect();
     
@@ -688,6 +843,7 @@ C64::_setDebug(bool enable)
 {
     suspend();
     updateVicFunctionTable();
+    updateRunLoopFunctions();
     resume();
 }
 
@@ -804,16 +960,26 @@ C64::runLoop()
     while (1) {
         
         // Run the emulator
-        while (runLoopCtrl == 0) { executeOneFrame(); }
+        if (runAhead) {
+            while (runLoopCtrl.load(std::memory_order_relaxed) == 0) { executeOneFrameAhead(); }
+        } else {
+            while (runLoopCtrl.load(std::memory_order_relaxed) == 0) { executeOneFrame(); }
+        }
         
         // Check if special action needs to be taken
-        if (runLoopCtrl) {
+        if (runLoopCtrl.load(std::memory_order_acquire)) {
+            
+            // Are we requested to switch the run loop functions?
+            if (runLoopCtrl & RL_UPDATE_FUNCTIONS) {
+                debug(RUN_DEBUG, "RL_UPDATE_FUNCTIONS\n");
+                updateRunLoopFunctions();
+                clearControlFlags(RL_UPDATE_FUNCTIONS);
+            }
             
             // Are we requested to take a snapshot?
             if (runLoopCtrl & RL_AUTO_SNAPSHOT) {
                 debug(RUN_DEBUG, "RL_AUTO_SNAPSHOT\n");
-                autoSnapshot = Snapshot::makeWithC64(this);
-                putMessage(MSG_AUTO_SNAPSHOT_TAKEN);
+                autoSnapshots.submit(Snapshot::makeWithC64(this));
                 clearControlFlags(RL_AUTO_SNAPSHOT);
             }
             if (runLoopCtrl & RL_USER_SNAPSHOT) {
@@ -906,21 +1072,77 @@ C64::stepOver()
 void
 C64::executeOneFrame()
 {
-    do { executeOneLine(); } while (rasterLine != 0 && runLoopCtrl == 0);
+    do { executeOneLine(); } while (rasterLine != 0 && runLoopCtrl.load(std::memory_order_relaxed) == 0);
+}
+
+void
+C64::executeOneFrameAhead()
+{
+    // Breakpoints and watchpoints must not trigger in the future
+    if (cpu.inDebugMode()) { executeOneFrame(); return; }
+    
+    // Emulate the next frame
+    hiddenFrame = true;
+    executeOneFrame();
+    hiddenFrame = false;
+    if (runLoopCtrl.load(std::memory_order_relaxed)) return;
+    
+    // Save the current state
+    size_t stateSize = size();
+    if (stateSize != runAheadStateSize) {
+        
+        delete [] runAheadState;
+        runAheadState = new u8[stateSize];
+        runAheadStateSize = stateSize;
+    }
+    save(runAheadState);
+    
+    // Run ahead and present the last frame (the audio device hears nothing)
+    speculative = true;
+    sid.setDiscardSamples(true);
+    for (long i = 1; i <= runAhead && runLoopCtrl.load(std::memory_order_relaxed) == 0; i++) {
+        
+        hiddenFrame = i < runAhead;
+        executeOneFrame();
+    }
+    sid.setDiscardSamples(false);
+    speculative = false;
+    hiddenFrame = false;
+    
+    /* Preserve the input devices (the GUI might have changed them meanwhile)
+     * by overwriting their saved state in place. The control ports keep their
+     * state, because they don't serialize it and skip their reset below.
+     */
+    keyboard.save(runAheadState + keyboard.getSnapshotOffset());
+    mouse.save(runAheadState + mouse.getSnapshotOffset());
+    
+    // Return to the saved state
+    returningFromRunAhead = true;
+    load(runAheadState);
+    returningFromRunAhead = false;
+    
+    // Discard the events from the future
+    clearControlFlags(RL_BREAKPOINT_REACHED | RL_WATCHPOINT_REACHED | RL_CPU_JAMMED);
 }
 
 void
 C64::executeOneLine()
+{
+    (this->*lineFunc)();
+}
+
+template <bool drv8, bool drv9, bool tape, bool dbg> void
+C64::_executeOneLine()
 {
     // Emulate the beginning of a rasterline
     if (rasterCycle == 1) beginRasterLine();
     
     // Emulate the middle of a rasterline
-    int lastCycle = vic.getCyclesPerLine();
+    unsigned lastCycle = vic.getCyclesPerLine();
     for (unsigned i = rasterCycle; i <= lastCycle; i++) {
         
-        _executeOneCycle();
-        if (runLoopCtrl != 0) {
+        _executeOneCycle<drv8, drv9, tape, dbg>();
+        if (runLoopCtrl.load(std::memory_order_relaxed) != 0) {
             if (i == lastCycle) endRasterLine();
             return;
         }
@@ -937,11 +1159,11 @@ C64::executeOneCycle()
     bool isLastCycle = vic.isLastCycleInRasterline(rasterCycle);
     
     if (isFirstCycle) beginRasterLine();
-    _executeOneCycle();
+    (this->*cycleFunc)();
     if (isLastCycle) endRasterLine();
 }
 
-void
+template <bool drv8, bool drv9, bool tape, bool dbg> void
 C64::_executeOneCycle()
 {
     u64 cycle = ++cpu.cycle;
@@ -965,20 +1187,57 @@ C64::_executeOneCycle()
     // '-------------------------------------|-------------------|--'
     
     // First clock phase (o2 low)
+    profiler.enter(PROF_VIC);
     (vic.*vicfunc[rasterCycle])();
-    if (cycle >= cia1.wakeUpCycle) cia1.executeOneCycle();
-    if (cycle >= cia2.wakeUpCycle) cia2.executeOneCycle();
-    if (iec.isDirtyC64Side) iec.updateIecLinesC64Side();
+    profiler.leave();
+    if ((Cycle)cycle >= nextTrigger) serviceEvents(cycle);
     
     // Second clock phase (o2 high)
-    cpu.executeOneCycle();
-    if (drive8.isActive()) drive8.execute(durationOfOneCycle);
-    if (drive9.isActive()) drive9.execute(durationOfOneCycle);
-    datasette.execute();
+    profiler.enter(PROF_CPU);
+    cpu.executeOneCycle<dbg>();
+    profiler.leave();
+    if (drv8) drive8.execute(durationOfOneCycle);
+    if (drv9) drive9.execute(durationOfOneCycle);
+    if (tape) datasette.execute();
     
     rasterCycle++;
 }
 
+void
+C64::serviceEvents(Cycle cycle)
+{
+    if (cycle >= trigger[SLOT_CIA1]) {
+        profiler.enter(PROF_CIA1);
+        cia1.executeOneCycle();
+        profiler.leave();
+    }
+    if (cycle >= trigger[SLOT_CIA2]) {
+        profiler.enter(PROF_CIA2);
+        cia2.executeOneCycle();
+        profiler.leave();
+    }
+    if (cycle >= trigger[SLOT_IEC]) {
+        iec.updateIecLinesC64Side();
+        cancel(SLOT_IEC);
+    }
+    
+    // Determine the next trigger cycle
+    nextTrigger = trigger[SLOT_CIA1];
+    nextTrigger = MIN(nextTrigger, trigger[SLOT_CIA2]);
+    nextTrigger = MIN(nextTrigger, trigger[SLOT_IEC]);
+}
+
+void
+C64::rescheduleEvents()
+{
+    for (unsigned i = 0; i < SLOT_COUNT; i++) trigger[i] = NEVER;
+    nextTrigger = NEVER;
+    
+    scheduleAbs(SLOT_CIA1, cia1.wakeUpCycle);
+    scheduleAbs(SLOT_CIA2, cia2.wakeUpCycle);
+    if (iec.isDirtyC64Side) scheduleAbs(SLOT_IEC, cpu.cycle);
+}
+
 void
 C64::finishInstruction()
 {
@@ -988,17 +1247,24 @@ C64::finishInstruction()
 void
 C64::beginRasterLine()
 {
+    profiler.enter(PROF_VIC);
+    
     // First cycle of rasterline
     if (rasterLine == 0) {
         vic.beginFrame();
     }
     vic.beginRasterline(rasterLine);
+    
+    profiler.leave();
 }
 
 void
 C64::endRasterLine()
 {
+    profiler.enter(PROF_VIC);
     vic.endRasterline();
+    profiler.leave();
+    
     rasterCycle = 1;
     rasterLine++;
     
@@ -1011,8 +1277,10 @@ C64::endRasterLine()
 void
 C64::endFrame()
 {
+    profiler.enter(PROF_ENDFRAME);
+    
     frame++;
-    vic.endFrame();
+    if (!hiddenFrame) vic.endFrame();
     
     // Increment time of day clocks every tenth of a second
     cia1.incrementTOD();
@@ -1024,52 +1292,58 @@ C64::endFrame()
     // Execute other components
     iec.execute();
     expansionport.execute();
-    port1.execute();
-    port2.execute();
-    keyboard.vsyncHandler();
+    if (!speculative) {
+        
+        // Input devices are frozen while running ahead
+        port1.execute();
+        port2.execute();
+        keyboard.vsyncHandler();
+    }
+    drive8.catchUp();
+    drive9.catchUp();
     drive8.vsyncHandler();
     drive9.vsyncHandler();
 
     // Update mouse coordinates
-    mouse.execute();
+    if (!speculative) mouse.execute();
+    
+    // Record the new state in the rewind buffer
+    if (rewindBuffer.isEnabled() && !speculative) rewindBuffer.capture(*this);
+    
+    // Hand over the inspection target's state to the readers
+    if (inspectionRate && !speculative && frame % inspectionRate == 0) {
+        publishInspection();
+    }
     
     // Check if the run loop is requested to stop
     if (stopFlag) { stopFlag = false; signalStop(); }
     
+    profiler.leave();
+    
     // Count some sheep (zzzzzz) ...
-    if (!inWarpMode()) {
+    if (!inWarpMode() && !speculative) {
+        profiler.enter(PROF_IDLE);
         synchronizeTiming();
+        profiler.leave();
     }
-}
-
-void
-C64::setControlFlags(u32 flags)
-{
-    synchronized { runLoopCtrl |= flags; }
-}
-
-void
-C64::clearControlFlags(u32 flags)
-{
-    synchronized { runLoopCtrl &= ~flags; }
+    
+#if C64_PROFILING
+    synchronized { profiler.endFrame(profileInfo, frame); }
+#endif
 }
 
 void
 C64::restartTimer()
 {
-    u64 kernelNow = mach_absolute_time();
-    u64 nanoNow = abs_to_nanos(kernelNow);
-    
-    nanoTargetTime = nanoNow + vic.getFrameDelay();
+    nanoTargetTime = monotonicNanos() + vic.getFrameDelay();
+    synchronized { timingInfo.resyncs++; }
 }
 
 void
 C64::synchronizeTiming()
 {
-    const u64 earlyWakeup = 1500000; /* 1.5 milliseconds */
-    
     // Get current time in nano seconds
-    u64 nanoAbsTime = abs_to_nanos(mach_absolute_time());
+    u64 nanoAbsTime = monotonicNanos();
     
     // Check how long we're supposed to sleep
     i64 timediff = (i64)nanoTargetTime - (i64)nanoAbsTime;
@@ -1082,13 +1356,20 @@ C64::synchronizeTiming()
         restartTimer();
     }
     
-    // Convert nanoTargetTime into kernel unit
-    i64 kernelTargetTime = nanos_to_abs(nanoTargetTime);
-    
     // Sleep and update target timer
-    i64 jitter = sleepUntil(kernelTargetTime, earlyWakeup);
+    i64 jitter = sleepUntil(nanoTargetTime, spinWait);
     nanoTargetTime += vic.getFrameDelay();
     
+    // Record jitter statistics
+    synchronized {
+        
+        timingInfo.frames++;
+        timingInfo.jitter = jitter;
+        timingInfo.minJitter = MIN(timingInfo.minJitter, jitter);
+        timingInfo.maxJitter = MAX(timingInfo.maxJitter, jitter);
+        jitterSum += jitter;
+    }
+    
     if (jitter > 1000000000 /* 1 sec */) {
         
         // The emulator did not keep up with the real time clock. Instead of
@@ -1099,14 +1380,52 @@ C64::synchronizeTiming()
     }
 }
 
+TimingInfo
+C64::getTimingInfo()
+{
+    TimingInfo result;
+    
+    synchronized {
+        
+        result = timingInfo;
+        result.avgJitter = result.frames ? jitterSum / (i64)result.frames : 0;
+        if (result.frames == 0) result.minJitter = 0;
+    }
+    return result;
+}
+
+void
+C64::clearTimingInfo()
+{
+    synchronized {
+        
+        memset(&timingInfo, 0, sizeof(timingInfo));
+        timingInfo.minJitter = INT64_MAX;
+        jitterSum = 0;
+    }
+}
+
+ProfileInfo
+C64::getProfileInfo()
+{
+    ProfileInfo result;
+    synchronized { result = profileInfo; }
+    return result;
+}
+
+void
+C64::clearProfileInfo()
+{
+    synchronized { memset(&profileInfo, 0, sizeof(profileInfo)); }
+}
+
 void
 C64::requestAutoSnapshot()
 {
     if (!isRunning()) {
         
         // Take snapshot immediately
-        autoSnapshot = Snapshot::makeWithC64(this);
-        putMessage(MSG_AUTO_SNAPSHOT_TAKEN);
+        autoSnapshots.submit(Snapshot::makeWithC64(this));
         
     } else {
         
@@ -1134,9 +1453,7 @@ C64::requestUserSnapshot()
 Snapshot *
 C64::latestAutoSnapshot()
 {
-    Snapshot *result = autoSnapshot;
-    autoSnapshot = NULL;
-    return result;
+    return autoSnapshots.take();
 }
 
 Snapshot *
@@ -1153,12 +1470,40 @@ void C64::loadFromSnapshot(Snapshot *snapshot)
     
     if (snapshot && (ptr = snapshot->getData())) {
         
+        // Refuse to load a corrupted state
+        if (!snapshot->verify(snapshot->findChunk("C64"))) {
+            warn("Snapshot is corrupted\n");
+            return;
+        }
+        
         // Make sure the emulator is not running
         assert(!isRunning());
         
+        // Make the Roms stored in the snapshot available
+        vector<u8 *> roms;
+        for (long i = 0; i < snapshot->numChunks(); i++) {
+            
+            SnapshotChunk *chunk = snapshot->getChunk(i);
+            if (strncmp(chunk->name, "Rom/", 4) != 0) continue;
+            
+            // Only accept intact images of a supported Rom size
+            bool validSize =
+            chunk->size == 0x1000 || chunk->size == 0x2000 || chunk->size == 0x4000;
+            
+            if (!validSize || !snapshot->verify(chunk)) {
+                
+                warn("Snapshot chunk %s is corrupted\n", chunk->name);
+                for (u8 *rom : roms) RomStore::release(rom);
+                return;
+            }
+            roms.push_back(RomStore::acquire(snapshot->chunkData(chunk), chunk->size));
+        }
+        
         // Restore the saved state
         load(ptr);
         
+        for (u8 *rom : roms) RomStore::release(rom);
+        
         // Clear the keyboard matrix to avoid constantly pressed keys
         keyboard.releaseAll();
         
@@ -1167,17 +1512,53 @@ void C64::loadFromSnapshot(Snapshot *snapshot)
     }
 }
 
+void
+C64::setRewindBudget(size_t bytes)
+{
+    suspend();
+    rewindBuffer.setCapacity(bytes);
+    resume();
+}
+
+void
+C64::setRunAhead(long frames)
+{
+    assert(frames >= 0);
+    
+    suspend();
+    runAhead = frames;
+    resume();
+}
+
+long
+C64::rewindableFrames()
+{
+    return rewindBuffer.frames();
+}
+
+bool
+C64::rewind(long frames)
+{
+    bool result;
+    
+    suspend();
+    result = rewindBuffer.rewind(*this, frames);
+    resume();
+    
+    return result;
+}
+
 u32
 C64::romCRC32(RomType type)
 {
     switch (type) {
             
         case ROM_BASIC:
-            return hasRom(ROM_BASIC)  ? crc32(mem.rom + 0xA000, 0x2000) : 0;
+            return hasRom(ROM_BASIC)  ? crc32(mem.basicRom, 0x2000) : 0;
         case ROM_CHAR:
-            return hasRom(ROM_CHAR)   ? crc32(mem.rom + 0xD000, 0x1000) : 0;
+            return hasRom(ROM_CHAR)   ? crc32(mem.charRom, 0x1000) : 0;
         case ROM_KERNAL:
-            return hasRom(ROM_KERNAL) ? crc32(mem.rom + 0xE000, 0x2000) : 0;
+            return hasRom(ROM_KERNAL) ? crc32(mem.kernalRom, 0x2000) : 0;
         case ROM_VC1541:
             return hasRom(ROM_VC1541) ? crc32(drive8.mem.rom, 0x4000) : 0;
         default:
@@ -1189,19 +1570,19 @@ C64::romCRC32(RomType type)
 u32
 C64::basicRomCRC32()
 {
-    return hasBasicRom() ? crc32(mem.rom + 0xA000, 0x2000) : 0;
+    return hasBasicRom() ? crc32(mem.basicRom, 0x2000) : 0;
 }
 
 u32
 C64::charRomCRC32()
 {
-    return hasCharRom() ? crc32(mem.rom + 0xD000, 0x1000) : 0;
+    return hasCharRom() ? crc32(mem.charRom, 0x1000) : 0;
 }
 
 u32
 C64::kernalRomCRC32()
 {
-    return hasKernalRom() ? crc32(mem.rom + 0xE000, 0x2000) : 0;
+    return hasKernalRom() ? crc32(mem.kernalRom, 0x2000) : 0;
 }
 
 u32
@@ -1217,13 +1598,13 @@ C64::romFNV64(RomType type)
     switch (type) {
             
         case ROM_BASIC:
-            return hasRom(ROM_BASIC)  ? fnv_1a_64(mem.rom + 0xA000, 0x2000) : 0;
+            return hasRom(ROM_BASIC)  ? mem.basicRomFNV : 0;
         case ROM_CHAR:
-            return hasRom(ROM_CHAR)   ? fnv_1a_64(mem.rom + 0xD000, 0x1000) : 0;
+            return hasRom(ROM_CHAR)   ? mem.charRomFNV : 0;
         case ROM_KERNAL:
-            return hasRom(ROM_KERNAL) ? fnv_1a_64(mem.rom + 0xE000, 0x2000) : 0;
+            return hasRom(ROM_KERNAL) ? mem.kernalRomFNV : 0;
         case ROM_VC1541:
-            return hasRom(ROM_VC1541) ? fnv_1a_64(drive8.mem.rom, 0x4000) : 0;
+            return hasRom(ROM_VC1541) ? drive8.mem.romFNV : 0;
         default:
             assert(false);
     }
@@ -1360,20 +1741,19 @@ C64::hasRom(RomType type)
             
         case ROM_BASIC:
         {
-            return (mem.rom[0xA000] | mem.rom[0xA001]) != 0x00;
+            return (mem.basicRom[0] | mem.basicRom[1]) != 0x00;
         }
         case ROM_CHAR:
         {
-            return (mem.rom[0xD000] | mem.rom[0xD001]) != 0x00;
+            return (mem.charRom[0] | mem.charRom[1]) != 0x00;
         }
         case ROM_KERNAL:
         {
-            return (mem.rom[0xE000] | mem.rom[0xE001]) != 0x00;
+            return (mem.kernalRom[0] | mem.kernalRom[1]) != 0x00;
         }
         case ROM_VC1541:
         {
-            assert(drive8.mem.rom[0] == drive9.mem.rom[0]);
-            assert(drive8.mem.rom[1] == drive9.mem.rom[1]);
+            assert(drive8.mem.rom == drive9.mem.rom);
             return (drive8.mem.rom[0] | drive8.mem.rom[1]) != 0x00;
         }
         default: assert(false);
@@ -1388,7 +1768,7 @@ C64::hasMega65Rom(RomType type)
             
         case ROM_BASIC:
         {
-            return mem.rom[0xBF52] == 'O' && mem.rom[0xBF53] == 'R';
+            return mem.basicRom[0x1F52] == 'O' && mem.basicRom[0x1F53] == 'R';
         }
         case ROM_CHAR:
         {
@@ -1396,7 +1776,7 @@ C64::hasMega65Rom(RomType type)
         }
         case ROM_KERNAL:
         {
-            return mem.rom[0xE4B9] == 'O' && mem.rom[0xE4BA] == 'R';
+            return mem.kernalRom[0x04B9] == 'O' && mem.kernalRom[0x04BA] == 'R';
         }
         case ROM_VC1541:
         {
@@ -1413,7 +1793,7 @@ C64::mega65BasicRev()
     static char rev[17];
     rev[0] = 0;
     
-    if (hasMega65Rom(ROM_BASIC)) memcpy(rev, &mem.rom[0xBF55], 16);
+    if (hasMega65Rom(ROM_BASIC)) memcpy(rev, &mem.basicRom[0x1F55], 16);
     rev[16] = 0;
     
     return rev;
@@ -1425,7 +1805,7 @@ C64::mega65KernalRev()
     static char rev[17];
     rev[0] = 0;
     
-    if (hasMega65Rom(ROM_KERNAL)) memcpy(rev, &mem.rom[0xE4BC], 16);
+    if (hasMega65Rom(ROM_KERNAL)) memcpy(rev, &mem.kernalRom[0x04BC], 16);
     rev[16] = 0;
     
     return rev;
@@ -1442,7 +1822,7 @@ C64::loadRom(RomType type, RomFile *file)
         {
             if (file->type() == FILETYPE_BASIC_ROM) {
                 debug("Flashing Basic Rom\n");
-                file->flash(mem.rom, 0xA000);
+                flashRom(ROM_BASIC, file);
                 
                 debug("hasMega65Rom() = %d\n", hasMega65Rom(ROM_BASIC));
                 debug("mega65BasicRev() = %s\n", mega65BasicRev());
@@ -1455,7 +1835,7 @@ C64::loadRom(RomType type, RomFile *file)
         {
             if (file->type() == FILETYPE_CHAR_ROM) {
                 debug("Flashing Character Rom\n");
-                file->flash(mem.rom, 0xD000);
+                flashRom(ROM_CHAR, file);
                 return true;
             }
             return false;
@@ -1464,7 +1844,7 @@ C64::loadRom(RomType type, RomFile *file)
         {
             if (file->type() == FILETYPE_KERNAL_ROM) {
                 debug("Flashing Kernal Rom\n");
-                file->flash(mem.rom, 0xE000);
+                flashRom(ROM_KERNAL, file);
                 
                 debug("hasMega65Rom() = %d\n", hasMega65Rom(ROM_KERNAL));
                 debug("mega65KernalRev() = %s\n", mega65KernalRev());
@@ -1477,8 +1857,7 @@ C64::loadRom(RomType type, RomFile *file)
         {
             if (file->type() == FILETYPE_VC1541_ROM) {
                 debug("Flashing VC1541 Rom\n");
-                file->flash(drive8.mem.rom);
-                file->flash(drive9.mem.rom);
+                flashRom(ROM_VC1541, file);
                 return true;
             }
             return false;
@@ -1583,20 +1962,20 @@ C64::deleteRom(RomType type)
             
         case ROM_BASIC:
         {
-            memset(mem.rom + 0xA000, 0, 0x2000);
+            mem.installRom(ROM_BASIC, NULL);
         }
         case ROM_CHAR:
         {
-            memset(mem.rom + 0xD000, 0, 0x1000);
+            mem.installRom(ROM_CHAR, NULL);
         }
         case ROM_KERNAL:
         {
-            memset(mem.rom + 0xE000, 0, 0x2000);
+            mem.installRom(ROM_KERNAL, NULL);
         }
         case ROM_VC1541:
         {
-            memset(drive8.mem.rom, 0, 0x4000);
-            memset(drive9.mem.rom, 0, 0x4000);
+            drive8.mem.installRom(NULL);
+            drive9.mem.installRom(NULL);
         }
         default: assert(false);
     }
@@ -1611,21 +1990,21 @@ C64::saveRom(RomType type, const char *path)
         {
             if (!hasRom(ROM_BASIC)) return false;
             
-            RomFile *file = RomFile::makeWithBuffer(mem.rom + 0xA000, 0x2000);
+            RomFile *file = RomFile::makeWithBuffer(mem.basicRom, 0x2000);
             return file && file->writeToFile(path);
         }
         case ROM_CHAR:
         {
             if (!hasRom(ROM_CHAR)) return false;
             
-            RomFile *file = RomFile::makeWithBuffer(mem.rom + 0xD000, 0x1000);
+            RomFile *file = RomFile::makeWithBuffer(mem.charRom, 0x1000);
             return file && file->writeToFile(path);
         }
         case ROM_KERNAL:
         {
             if (!hasRom(ROM_KERNAL)) return false;
             
-            RomFile *file = RomFile::makeWithBuffer(mem.rom + 0xE000, 0x2000);
+            RomFile *file = RomFile::makeWithBuffer(mem.kernalRom, 0x2000);
             return file && file->writeToFile(path);
         }
         case ROM_VC1541:
@@ -1640,6 +2019,24 @@ C64::saveRom(RomType type, const char *path)
     return false;
 }
 
+void
+C64::flashRom(RomType type, AnyFile *file)
+{
+    u8 buffer[0x4000];
+    
+    assert(file->getSize() <= sizeof(buffer));
+    
+    memset(buffer, 0, sizeof(buffer));
+    file->flash(buffer);
+    
+    if (type == ROM_VC1541) {
+        drive8.mem.installRom(buffer);
+        drive9.mem.installRom(buffer);
+    } else {
+        mem.installRom(type, buffer);
+    }
+}
+
 bool
 C64::flash(AnyFile *file)
 {
@@ -1649,20 +2046,19 @@ C64::flash(AnyFile *file)
     switch (file->type()) {
             
         case FILETYPE_BASIC_ROM:
-            file->flash(mem.rom, 0xA000);
+            flashRom(ROM_BASIC, file);
             break;
             
         case FILETYPE_CHAR_ROM:
-            file->flash(mem.rom, 0xD000);
+            flashRom(ROM_CHAR, file);
             break;
             
         case FILETYPE_KERNAL_ROM:
-            file->flash(mem.rom, 0xE000);
+            flashRom(ROM_KERNAL, file);
             break;
             
         case FILETYPE_VC1541_ROM:
-            file->flash(drive8.mem.rom);
-            file->flash(drive9.mem.rom);
+            flashRom(ROM_VC1541, file);
             break;
             
         case FILETYPE_V64:
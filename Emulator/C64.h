@@ -21,8 +21,14 @@
 // Data types and constants
 #include "C64Types.h"
 
+// Instrumentation
+#include "Profiler.h"
+
 // Loading and saving
 #include "Snapshot.h"
+#include "RewindBuffer.h"
+#include "SnapshotCompressor.h"
+#include "TripleBuffer.h"
 #include "T64File.h"
 #include "D64File.h"
 #include "G64File.h"
@@ -38,6 +44,7 @@
 #include "IEC.h"
 #include "Keyboard.h"
 #include "ControlPort.h"
+#include "RomStore.h"
 #include "C64Memory.h"
 #include "DriveMemory.h"
 #include "FlashRom.h"
@@ -67,7 +74,20 @@
 class C64 : public HardwareComponent {
         
     // The currently set inspection target (only evaluated in debug mode)
-    InspectionTarget inspectionTarget;
+    InspectionTarget inspectionTarget = INSPECT_NONE;
+    
+    /* Number of frames between two published inspections (0 = disabled).
+     * If enabled, the inspection target is inspected at the end of a frame
+     * and the result is handed over to the readers via a triple buffer.
+     */
+    long inspectionRate = 0;
+    TripleBuffer<InspectionInfo> inspections;
+    
+    /* Mutex serializing the readers of the triple buffer. Picking up a new
+     * inspection swaps the consumer slot, which is only safe for a single
+     * consumer. The producer side stays lock-free.
+     */
+    pthread_mutex_t inspectionLock;
 
     
     //
@@ -149,6 +169,33 @@ public:
      */
     void (VICII::*vicfunc[66])(void);
     
+    /* The run loop functions. Both pointers refer to template instances of
+     * _executeOneLine() and _executeOneCycle() which are specialized for the
+     * currently active peripherals. Hence, no runtime checks are needed
+     * inside the innermost emulation loop to skip inactive components.
+     */
+    void (C64::*lineFunc)(void);
+    void (C64::*cycleFunc)(void);
+    
+    
+    //
+    // Event scheduling
+    //
+    
+private:
+    
+    /* Trigger cycles of all event slots. Each entry stores the cycle in which
+     * the component associated with the slot needs to be executed next. The
+     * component is executed in each cycle as long as the trigger cycle is
+     * reached. Slots of idle components are set to NEVER.
+     */
+    Cycle trigger[SLOT_COUNT];
+    
+    /* The earliest trigger cycle among all slots. This value is checked in
+     * each cycle. It is updated each time an event is scheduled or serviced.
+     */
+    Cycle nextTrigger;
+    
     
     //
     // Emulator thread
@@ -160,9 +207,12 @@ private:
      * iteration. Most of the time, the variable is 0 which causes the runloop
      * to repeat. A value greater than 0 means that one or more runloop control
      * flags are set. These flags are flags processed and the loop either
-     * repeats or terminates depending on the provided flags.
+     * repeats or terminates depending on the provided flags. The variable is
+     * atomic. Flags can be set or cleared from any thread without locking.
+     * The emulation loops poll the variable with relaxed loads. The run loop
+     * performs an acquire load before it acts on the flags.
      */
-    u32 runLoopCtrl = 0;
+    std::atomic<u32> runLoopCtrl { 0 };
     
     /* Stop request. This variable is used to signal a stop request coming from
      * the GUI. The variable is checked after each frame.
@@ -190,16 +240,36 @@ private:
     
 private:
     
-    /* System timer information. Used to match the emulation speed with the
-     * speed of a real C64.
-     */
-    mach_timebase_info_data_t timebase;
-    
     /* Wake-up time of the synchronization timer in nanoseconds. This value is
-     * recomputed each time the emulator thread is put to sleep.
+     * recomputed each time the emulator thread is put to sleep. It refers to
+     * the monotonic host clock as returned by monotonicNanos().
      */
     u64 nanoTargetTime;
     
+    /* Duration of the final busy-wait phase in nanoseconds. To match the
+     * target time precisely, the emulator thread wakes up earlier by this
+     * amount and waits actively until the deadline is reached. Larger values
+     * decrease jitter at the expense of burning more host cycles.
+     */
+    u64 spinWait = 1500000;
+    
+    // Collected jitter statistics
+    TimingInfo timingInfo;
+    
+    // Sum of all recorded jitter values (used to compute the average)
+    i64 jitterSum;
+    
+    // Collected profiling data (only updated if C64_PROFILING is set)
+    ProfileInfo profileInfo;
+    
+public:
+    
+    // Measures the host time spent in each component
+    Profiler profiler;
+    
+    // Recent history of the emulator state (for rewinding)
+    RewindBuffer rewindBuffer;
+    
 
     //
     // Operation modes
@@ -219,7 +289,9 @@ private:
     
 private:
     
-    Snapshot *autoSnapshot = NULL;
+    // Compresses automatically taken snapshots in the background
+    SnapshotCompressor autoSnapshots = SnapshotCompressor(*this);
+    
     Snapshot *userSnapshot = NULL;
     
     //
@@ -266,6 +338,23 @@ public:
     // Updates the VICII function table according to the selected model
     void updateVicFunctionTable();
 
+    /* Selects the run loop functions matching the set of active peripherals
+     * and the debug mode setting. It also enables or disables the watchpoint
+     * checks of the memory page table. This function needs to be called
+     * whenever a drive is activated or deactivated, the play key of the
+     * datasette changes its state, debug mode is entered or left, or
+     * watchpoints are added or removed. It must only be called if the
+     * emulator thread is not running or by the emulator thread itself.
+     */
+    void updateRunLoopFunctions();
+    
+    /* Thread-safe variant of updateRunLoopFunctions(). If the emulator is
+     * running, the function pointers are not touched by the calling thread.
+     * Instead, the run loop is signalled to update them in between two
+     * cycles.
+     */
+    void requestRunLoopUpdate();
+
 private:
 
     bool setConfigItem(ConfigOption option, long value) override;
@@ -281,8 +370,27 @@ public:
     void setInspectionTarget(InspectionTarget target);
     void clearInspectionTarget();
     
+    /* Sets the number of frames between two published inspections. The
+     * inspection takes place inside the emulator thread at the end of a
+     * frame. Hence, the run loop is not interrupted. A value of 0 disables
+     * publishing.
+     */
+    long getInspectionRate() { return inspectionRate; }
+    void setInspectionRate(long frames) { inspectionRate = MAX(frames, 0); }
+    
+    /* Copies the most recently published inspection. Returns false if nothing
+     * new has been published since the last call by any thread. The function
+     * can be called from multiple threads. Readers are serialized by a mutex,
+     * which never blocks the emulator thread.
+     */
+    bool getInspection(InspectionInfo &result);
+    
 private:
     
+    // Inspects the inspection target and publishes the result
+    void publishInspection();
+    
+    
     void _dump() override;
 
     
@@ -318,6 +426,8 @@ private:
     size_t _load(u8 *buffer) override { LOAD_SNAPSHOT_ITEMS }
     size_t _save(u8 *buffer) override { SAVE_SNAPSHOT_ITEMS }
     
+    size_t didLoadFromBuffer(u8 *buffer) override;
+    
     
     //
     // Controlling
@@ -439,14 +549,39 @@ public:
      */
     void executeOneFrame();
     
+    /* Emulates one frame in run-ahead mode. The C64 is emulated for one frame
+     * without presenting it. Then, the state is saved and the C64 runs ahead
+     * for the configured number of frames with the current input. The last of
+     * these frames is presented. Afterwards, the saved state is restored.
+     */
+    void executeOneFrameAhead();
+    
     /* Emulates the C64 until the end of the current rasterline. This function
      * is called inside executeOneFrame().
      */
     void executeOneLine();
+    template <bool drv8, bool drv9, bool tape, bool dbg> void _executeOneLine();
     
     // Executes a single clock cycle
     void executeOneCycle();
-    void _executeOneCycle();
+    template <bool drv8, bool drv9, bool tape, bool dbg> void _executeOneCycle();
+    
+    // Schedules an event in the specified slot
+    void scheduleAbs(EventSlot s, Cycle cycle) {
+        
+        assert(isEventSlot(s));
+        trigger[s] = cycle;
+        if (cycle < nextTrigger) nextTrigger = cycle;
+    }
+    
+    // Removes a scheduled event from the specified slot
+    void cancel(EventSlot s) { assert(isEventSlot(s)); trigger[s] = NEVER; }
+    
+    /* Recomputes all trigger cycles from the current component states. This
+     * function is called after the emulator state has been reset or restored
+     * from a snapshot.
+     */
+    void rescheduleEvents();
 
     /* Finishes the current instruction. This function is called when the
      * emulator threads terminates in order to reach a clean state. It emulates
@@ -465,6 +600,9 @@ private:
     // Invoked after executing the last rasterline of a frame
     void endFrame();
     
+    // Executes all components whose trigger cycle has been reached
+    void serviceEvents(Cycle cycle);
+    
     
     //
     // Managing the emulator thread
@@ -492,11 +630,12 @@ public:
     void suspend();
     void resume();
     
-    /* Sets or clears a run loop control flag. The functions are thread-safe
-     * and can be called from inside or outside the emulator thread.
+    /* Sets, clears, or reads the run loop control flags. The functions are
+     * lock-free and can be called from inside or outside the emulator thread.
      */
-    void setControlFlags(u32 flags);
-    void clearControlFlags(u32 flags);
+    void setControlFlags(u32 flags) { runLoopCtrl.fetch_or(flags); }
+    void clearControlFlags(u32 flags) { runLoopCtrl.fetch_and(~flags); }
+    u32 getControlFlags() { return runLoopCtrl; }
     
     // Convenience wrappers for controlling the run loop
     void signalAutoSnapshot() { setControlFlags(RL_AUTO_SNAPSHOT); }
@@ -506,6 +645,7 @@ public:
     void signalInspect() { setControlFlags(RL_INSPECT); }
     void signalJammed() { setControlFlags(RL_CPU_JAMMED); }
     void signalStop() { setControlFlags(RL_STOP); }
+    void signalFunctionUpdate() { setControlFlags(RL_UPDATE_FUNCTIONS); }
 
 private:
 
@@ -515,12 +655,6 @@ private:
      */
     void restartTimer();
     
-    // Converts kernel time to nanoseconds
-    u64 abs_to_nanos(u64 abs) { return abs * timebase.numer / timebase.denom; }
-    
-    // Converts nanoseconds to kernel time
-    u64 nanos_to_abs(u64 nanos) { return nanos * timebase.denom / timebase.numer; }
- 
     /* Puts the emulation the thread to sleep. This function is called inside
      * endFrame(). It makes the emulation thread wait until nanoTargetTime has
      * been reached. Before returning, nanoTargetTime is assigned with a new
@@ -528,6 +662,42 @@ private:
      */
     void synchronizeTiming();
     
+public:
+    
+    // Gets or sets the duration of the busy-wait phase in nanoseconds
+    u64 getSpinWait() { return spinWait; }
+    void setSpinWait(u64 nanos) { spinWait = nanos; }
+    
+    // Returns the collected frame pacing statistics
+    TimingInfo getTimingInfo();
+    
+    // Clears the frame pacing statistics
+    void clearTimingInfo();
+    
+    // Returns the profiling results of the most recent frame
+    ProfileInfo getProfileInfo();
+    
+    // Clears the accumulated profiling results
+    void clearProfileInfo();
+    
+    
+    //
+    // Generating random numbers
+    //
+    
+private:
+    
+    // State of the random number generator
+    u32 randomState = 1;
+    
+public:
+    
+    /* Each emulator instance has its own random number generator. Hence,
+     * instances don't influence each other and can run concurrently.
+     */
+    void seedRandom(u32 seed) { randomState = seed ? seed : 1; }
+    u32 random() { return xorshift32(randomState); }
+    
     
     //
     // Handling snapshots
@@ -538,7 +708,8 @@ public:
     /* Requests a snapshot to be taken. Once the snapshot is ready, a message
      * is written into the message queue. The snapshot can then be picked up by
      * calling latestAutoSnapshot() or latestUserSnapshot(), depending on the
-     * requested snapshot type.
+     * requested snapshot type. Auto snapshots are compressed in the
+     * background. Hence, the message is sent with a short delay.
      */
     void requestAutoSnapshot();
     void requestUserSnapshot();
@@ -553,6 +724,67 @@ public:
     void loadFromSnapshot(Snapshot *snapshot);
     
     
+    //
+    // Rewinding
+    //
+    
+public:
+    
+    /* Sets the memory budget of the rewind buffer in bytes. A value of 0
+     * disables rewinding. Changing the budget discards all recorded frames.
+     * The budget includes the keyframe and the scratch buffers of the rewind
+     * buffer (see RewindBuffer::setCapacity()).
+     */
+    void setRewindBudget(size_t bytes);
+    
+    // Returns the number of frames that can be rewound
+    long rewindableFrames();
+    
+    /* Restores the state that was reached the specified number of frames ago.
+     * Returns false if the rewind buffer does not reach back that far.
+     */
+    bool rewind(long frames);
+    
+    
+    //
+    // Running ahead
+    //
+    
+private:
+    
+    // Number of frames to run ahead (0 = run-ahead is disabled)
+    long runAhead = 0;
+    
+    // Saved emulator state to return to after running ahead
+    u8 *runAheadState = NULL;
+    size_t runAheadStateSize = 0;
+    
+    // Indicates that the emulator is running ahead
+    bool speculative = false;
+    
+    // Indicates that the current frame is emulated, but not presented
+    bool hiddenFrame = false;
+    
+    /* Indicates that the saved state is being restored after running ahead.
+     * Unlike a snapshot restore, this must not discard any host-side state
+     * such as pressed joystick buttons or the audio ringbuffer.
+     */
+    bool returningFromRunAhead = false;
+    
+public:
+    
+    // Returns true while the state saved before running ahead is restored
+    bool isReturningFromRunAhead() { return returningFromRunAhead; }
+    
+    /* Gets or sets the number of frames to run ahead. Running ahead reduces
+     * the perceived input latency by the specified number of frames. The
+     * emulation speed drops accordingly, because each frame is emulated
+     * multiple times.
+     */
+    long getRunAhead() { return runAhead; }
+    void setRunAhead(long frames);
+    
+    
     //
     // Handling Roms
     //
@@ -598,6 +830,13 @@ public:
     
     // Saves a Rom to disk
     bool saveRom(RomType rom, const char *path);
+
+private:
+    
+    // Installs the contents of a Rom file
+    void flashRom(RomType type, AnyFile *file);
+    
+public:
     
     
     //
@@ -17,13 +17,51 @@
 // Snapshot version number
 #define V_MAJOR 3
 #define V_MINOR 3
-#define V_SUBMINOR 0
+#define V_SUBMINOR 3
 
 // Uncomment these settings in a release build
 // #define RELEASEBUILD
 // #define NDEBUG
 
 
+//
+// Performance settings
+//
+
+/* Micro instruction dispatch of the CPU. If set to 1, executeOneCycle()
+ * branches to the next micro instruction via a table of label addresses
+ * (computed goto). Otherwise, a switch statement is used. Computed goto is
+ * a language extension supported by GCC and Clang. It is an opt-in
+ * experiment, because it hasn't shown a measurable speedup over the switch
+ * statement so far.
+ */
+#ifndef CPU_COMPUTED_GOTO
+#define CPU_COMPUTED_GOTO 0
+#endif
+
+/* Canvas drawing. If set to 1, VICII::drawCanvas() draws all eight canvas
+ * pixels of a cycle at once with SSE2 or NEON instructions, provided that no
+ * register change takes effect in the middle of the cycle. Otherwise, or if
+ * neither instruction set is available, the pixels are drawn one by one.
+ */
+#ifndef VICII_SIMD
+#if defined(__SSE2__) || defined(__ARM_NEON)
+#define VICII_SIMD 1
+#else
+#define VICII_SIMD 0
+#endif
+#endif
+
+/* Cycle-cost profiler. If set to 1, the run loop measures the host time spent
+ * in each major component and publishes the results once per frame (see
+ * C64::getProfileInfo()). The measurements are based on the time stamp
+ * counter where available. If set to 0, all instrumentation is compiled out.
+ */
+#ifndef C64_PROFILING
+#define C64_PROFILING 0
+#endif
+
+
 //
 // Debug settings
 //
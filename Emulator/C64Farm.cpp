@@ -0,0 +1,302 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#include "C64Farm.h"
+
+C64Farm::C64Farm(long numWorkers)
+{
+    setDescription("C64Farm");
+    
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&started, NULL);
+    pthread_cond_init(&finished, NULL);
+    
+    if (numWorkers <= 0) numWorkers = numCores();
+    
+    // Launch the workers
+    for (long i = 0; i < numWorkers; i++) {
+        
+        Worker *worker = new Worker();
+        worker->farm = this;
+        worker->nr = i;
+        pthread_mutex_init(&worker->lock, NULL);
+        
+        if (pthread_create(&worker->thread, NULL, workerMain, (void *)worker) != 0) {
+            
+            warn("Failed to launch worker %ld\n", i);
+            pthread_mutex_destroy(&worker->lock);
+            delete worker;
+            break;
+        }
+        workers.push_back(worker);
+    }
+    
+    // We need at least a single worker
+    if (workers.empty()) {
+        panic("C64Farm: Unable to launch a worker thread\n");
+    }
+}
+
+C64Farm::~C64Farm()
+{
+    // Terminate the workers
+    pthread_mutex_lock(&lock);
+    terminate = true;
+    pthread_cond_broadcast(&started);
+    pthread_mutex_unlock(&lock);
+    
+    for (auto &worker : workers) {
+        
+        pthread_join(worker->thread, NULL);
+        pthread_mutex_destroy(&worker->lock);
+        delete worker;
+    }
+    
+    // Delete the instances
+    for (auto &instance : instances) {
+        
+        delete instance->c64;
+        delete instance;
+    }
+    
+    pthread_cond_destroy(&finished);
+    pthread_cond_destroy(&started);
+    pthread_mutex_destroy(&lock);
+}
+
+long
+C64Farm::numCores()
+{
+    long result = sysconf(_SC_NPROCESSORS_ONLN);
+    return result > 0 ? result : 1;
+}
+
+long
+C64Farm::add(C64 *c64, long affinity)
+{
+    assert(c64 != NULL);
+    assert(!c64->isRunning());
+    
+    c64->setWarp(true);
+    
+    Instance *instance = new Instance();
+    instance->c64 = c64;
+    instance->affinity = affinity;
+    instance->remaining = 0;
+    
+    instances.push_back(instance);
+    return count() - 1;
+}
+
+void
+C64Farm::run(long frames)
+{
+    if (frames <= 0 || instances.empty()) return;
+    
+    /* Workers of the previous run may still be looking for work to steal.
+     * They might pick up and finish an instance as soon as it is queued.
+     * Hence, the counter must be set up before the queues are filled.
+     */
+    pthread_mutex_lock(&lock);
+    pending = count();
+    pthread_mutex_unlock(&lock);
+    
+    // Distribute the instances among the workers
+    long next = 0;
+    for (auto &instance : instances) {
+        
+        instance->remaining = frames;
+        
+        long nr = instance->affinity >= 0 ?
+        instance->affinity % numWorkers() : next++ % numWorkers();
+        
+        // The queue is locked, because other workers might be stealing
+        Worker *worker = workers[nr];
+        pthread_mutex_lock(&worker->lock);
+        worker->queue.push_back(instance);
+        pthread_mutex_unlock(&worker->lock);
+    }
+    
+    // Start the run and wait until all instances are done
+    pthread_mutex_lock(&lock);
+    generation++;
+    pthread_cond_broadcast(&started);
+    while (pending > 0) pthread_cond_wait(&finished, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+FarmInstanceInfo
+C64Farm::getInfo(long nr)
+{
+    assert(nr >= 0 && nr < count());
+    
+    Instance *instance = instances[nr];
+    FarmInstanceInfo result;
+    
+    result.frames = instance->frames;
+    result.nanos = instance->nanos;
+    result.slices = instance->slices;
+    result.steals = instance->steals;
+    result.fps = result.nanos ? result.frames * 1000000000.0 / result.nanos : 0.0;
+    result.worker = instance->worker;
+    result.halted = instance->c64->getControlFlags() != 0;
+    
+    return result;
+}
+
+void
+C64Farm::clearInfo()
+{
+    for (auto &instance : instances) {
+        
+        instance->frames = 0;
+        instance->nanos = 0;
+        instance->slices = 0;
+        instance->steals = 0;
+        instance->worker = -1;
+    }
+}
+
+void *
+C64Farm::workerMain(void *worker)
+{
+    Worker *w = (Worker *)worker;
+    w->farm->work(w);
+    return NULL;
+}
+
+void
+C64Farm::work(Worker *worker)
+{
+    long processed = 0;
+    
+    while (1) {
+        
+        // Wait for the next run
+        pthread_mutex_lock(&lock);
+        while (!terminate && generation == processed) {
+            pthread_cond_wait(&started, &lock);
+        }
+        if (terminate) { pthread_mutex_unlock(&lock); break; }
+        processed = generation;
+        pthread_mutex_unlock(&lock);
+        
+        process(worker);
+    }
+}
+
+void
+C64Farm::process(Worker *worker)
+{
+    while (1) {
+        
+        bool stolen = false;
+        Instance *instance = pop(worker);
+        
+        if (!instance) {
+            
+            // Our own queue is empty. Help out the others.
+            if (!(instance = steal(worker))) break;
+            stolen = true;
+        }
+        
+        emulate(worker, instance, stolen);
+        
+        // Keep the instance if it isn't done
+        if (instance->remaining > 0) {
+            
+            push(worker, instance);
+            
+        } else {
+            
+            pthread_mutex_lock(&lock);
+            if (--pending == 0) pthread_cond_signal(&finished);
+            pthread_mutex_unlock(&lock);
+        }
+    }
+}
+
+C64Farm::Instance *
+C64Farm::pop(Worker *worker)
+{
+    Instance *result = NULL;
+    
+    pthread_mutex_lock(&worker->lock);
+    if (!worker->queue.empty()) {
+        result = worker->queue.front();
+        worker->queue.pop_front();
+    }
+    pthread_mutex_unlock(&worker->lock);
+    
+    return result;
+}
+
+C64Farm::Instance *
+C64Farm::steal(Worker *thief)
+{
+    long n = numWorkers();
+    
+    // Visit the other workers, starting with the next one
+    for (long i = 1; i < n; i++) {
+        
+        Worker *victim = workers[(thief->nr + i) % n];
+        Instance *result = NULL;
+        
+        pthread_mutex_lock(&victim->lock);
+        if (!victim->queue.empty()) {
+            result = victim->queue.back();
+            victim->queue.pop_back();
+        }
+        pthread_mutex_unlock(&victim->lock);
+        
+        if (result) return result;
+    }
+    
+    return NULL;
+}
+
+void
+C64Farm::push(Worker *worker, Instance *instance)
+{
+    pthread_mutex_lock(&worker->lock);
+    worker->queue.push_front(instance);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+void
+C64Farm::emulate(Worker *worker, Instance *instance, bool stolen)
+{
+    C64 *c64 = instance->c64;
+    
+    // Skip halted instances
+    if (c64->getControlFlags()) {
+        instance->remaining = 0;
+        return;
+    }
+    
+    long frames = MIN(sliceFrames, instance->remaining);
+    u64 start = monotonicNanos();
+    u64 startFrame = c64->frame;
+    
+    for (long i = 0; i < frames; i++) {
+        
+        c64->executeOneFrame();
+        
+        // Stop if a run loop control flag has been set
+        if (c64->getControlFlags()) { instance->remaining = 0; break; }
+    }
+    
+    if (instance->remaining) instance->remaining -= frames;
+    
+    instance->frames += c64->frame - startFrame;
+    instance->nanos += monotonicNanos() - start;
+    instance->slices++;
+    if (stolen) instance->steals++;
+    instance->worker = worker->nr;
+}
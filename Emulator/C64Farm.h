@@ -0,0 +1,172 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#ifndef _C64FARM_H
+#define _C64FARM_H
+
+#include "C64.h"
+#include <deque>
+
+/* Runs many independent emulator instances on a pool of worker threads.
+ *
+ * The farm owns its instances. None of them runs an emulator thread of its
+ * own. Instead, the workers emulate the instances in slices of a few frames
+ * by calling executeOneFrame(). Each worker has a queue of instances. It
+ * takes the instance at the front of its own queue, emulates a slice, and
+ * puts the instance back to the front as long as frames remain. Hence, a
+ * worker sticks with an instance, which keeps the instance's state in the
+ * caches of its core. A worker whose queue runs empty steals the instance at
+ * the back of another worker's queue. No instance is ever emulated by two
+ * workers at the same time.
+ *
+ * The affinity hint of an instance determines the queue the instance is put
+ * in when a run starts. Instances without a hint are distributed round-robin.
+ *
+ * An instance halts if one of its run loop control flags is set after a slice
+ * (e.g., because the CPU has jammed). Halted instances are skipped until the
+ * flags are cleared.
+ */
+class C64Farm : public C64Object {
+    
+    // A single emulator instance
+    struct Instance {
+        
+        C64 *c64;
+        
+        // Preferred worker (-1 = none)
+        long affinity;
+        
+        // Number of frames left in the current run
+        long remaining;
+        
+        // Throughput counters
+        std::atomic<u64> frames { 0 };
+        std::atomic<u64> nanos { 0 };
+        std::atomic<u64> slices { 0 };
+        std::atomic<u64> steals { 0 };
+        std::atomic<long> worker { -1 };
+    };
+    
+    // A worker thread and its queue of instances
+    struct Worker {
+        
+        C64Farm *farm;
+        long nr;
+        pthread_t thread;
+        
+        // Protects the queue
+        pthread_mutex_t lock;
+        std::deque<Instance *> queue;
+    };
+    
+    // All instances
+    vector<Instance *> instances;
+    
+    // All workers
+    vector<Worker *> workers;
+    
+    // Number of frames emulated in a single slice
+    long sliceFrames = 5;
+    
+    // Protects the variables below
+    pthread_mutex_t lock;
+    
+    // Signals the start of a run (workers) and its completion (run())
+    pthread_cond_t started;
+    pthread_cond_t finished;
+    
+    // Incremented whenever a run starts
+    long generation = 0;
+    
+    // Number of instances that haven't finished the current run
+    long pending = 0;
+    
+    // Signals the workers to terminate
+    bool terminate = false;
+    
+    
+    //
+    // Initializing
+    //
+    
+public:
+    
+    // Creates a farm with the specified number of workers (0 = one per core)
+    C64Farm(long numWorkers = 0);
+    ~C64Farm();
+    
+    // Returns the number of cores of the host
+    static long numCores();
+    
+    
+    //
+    // Managing instances
+    //
+    
+public:
+    
+    /* Adds an instance and returns its number. The farm takes ownership. The
+     * instance must not run an emulator thread. It is switched to warp mode.
+     */
+    long add(C64 *c64, long affinity = -1);
+    
+    // Returns the number of instances or a single instance
+    long count() { return (long)instances.size(); }
+    C64 *instance(long nr) { return instances[nr]->c64; }
+    
+    // Returns the number of worker threads
+    long numWorkers() { return (long)workers.size(); }
+    
+    // Gets or sets the number of frames emulated in one go
+    long getSliceFrames() { return sliceFrames; }
+    void setSliceFrames(long frames) { sliceFrames = MAX(frames, 1); }
+    
+    
+    //
+    // Running
+    //
+    
+public:
+    
+    /* Emulates the specified number of frames in all instances. The function
+     * blocks until all instances have finished or halted.
+     */
+    void run(long frames);
+    
+    // Returns the throughput counters of an instance
+    FarmInstanceInfo getInfo(long nr);
+    
+    // Resets all throughput counters
+    void clearInfo();
+    
+private:
+    
+    // Entry point of the worker threads
+    static void *workerMain(void *worker);
+    
+    // Waits for runs and processes them until the farm is destroyed
+    void work(Worker *worker);
+    
+    // Processes instances until no more work is available
+    void process(Worker *worker);
+    
+    // Takes an instance from the front of a worker's own queue
+    Instance *pop(Worker *worker);
+    
+    // Takes an instance from the back of another worker's queue
+    Instance *steal(Worker *thief);
+    
+    // Puts an instance to the front of a worker's queue
+    void push(Worker *worker, Instance *instance);
+    
+    // Emulates a single slice
+    void emulate(Worker *worker, Instance *instance, bool stolen);
+};
+
+#endif
@@ -13,4 +13,23 @@
 #include "VICIIPrivateTypes.h"
 #include "DiskPrivateTypes.h"
 
+// Trigger cycle of an event that is not scheduled
+#define NEVER INT64_MAX
+
+/* Event slots. Each slot represents a component that is executed inside
+ * C64::_executeOneCycle() on demand, only. All slots are serviced in the
+ * first clock phase (o2 low).
+ */
+typedef enum
+{
+    SLOT_CIA1,
+    SLOT_CIA2,
+    SLOT_IEC,
+    
+    SLOT_COUNT
+}
+EventSlot;
+
+inline bool isEventSlot(long value) { return value >= 0 && value < SLOT_COUNT; }
+
 #endif
@@ -55,6 +55,9 @@ typedef enum : long
     OPT_CUT_OPACITY,
     OPT_SS_COLLISIONS,
     OPT_SB_COLLISIONS,
+    OPT_INDEXED_TEXTURE,
+    OPT_FRAME_SKIP,
+    OPT_VIC_HEADLESS,
 
     // Logic board
     OPT_GLUE_LOGIC,
@@ -78,6 +81,7 @@ typedef enum : long
     OPT_DRIVE_TYPE,
     OPT_DRIVE_CONNECT,
     OPT_DRIVE_POWER_SWITCH,
+    OPT_DRIVE_FAST_CPU,
     
     // Debugging
     OPT_DEBUGCART
@@ -128,13 +132,14 @@ inline bool isEmulatorState(long value) {
 
 typedef enum
 {
-    RL_STOP               = 0b0000001,
-    RL_CPU_JAMMED         = 0b0000010,
-    RL_INSPECT            = 0b0000100,
-    RL_BREAKPOINT_REACHED = 0b0001000,
-    RL_WATCHPOINT_REACHED = 0b0010000,
-    RL_AUTO_SNAPSHOT      = 0b0100000,
-    RL_USER_SNAPSHOT      = 0b1000000
+    RL_STOP               = 0b00000001,
+    RL_CPU_JAMMED         = 0b00000010,
+    RL_INSPECT            = 0b00000100,
+    RL_BREAKPOINT_REACHED = 0b00001000,
+    RL_WATCHPOINT_REACHED = 0b00010000,
+    RL_AUTO_SNAPSHOT      = 0b00100000,
+    RL_USER_SNAPSHOT      = 0b01000000,
+    RL_UPDATE_FUNCTIONS   = 0b10000000
 }
 RunLoopControlFlag;
 
@@ -165,6 +170,42 @@ inline bool isErrorCode(long value) {
     return value >= ERR_OK && value <= ERR_ROM_MEGA65_MISMATCH;
 }
 
+typedef enum : long
+{
+    PROF_OTHER,     // Run loop overhead and components not listed below
+    PROF_VIC,       // VICII cycle functions, begin and end of rasterlines
+    PROF_CIA1,      // CIA 1 executeOneCycle()
+    PROF_CIA2,      // CIA 2 executeOneCycle()
+    PROF_CPU,       // CPU executeOneCycle()
+    PROF_DRIVE,     // Drive execution (both drives)
+    PROF_SID,       // SIDBridge executeUntil()
+    PROF_ENDFRAME,  // End-of-frame housekeeping
+    PROF_IDLE,      // Waiting for the host clock
+    PROF_COUNT
+}
+ProfiledComponent;
+
+inline bool isProfiledComponent(long value) {
+    return value >= PROF_OTHER && value < PROF_COUNT;
+}
+
+inline const char *profiledComponentName(ProfiledComponent value) {
+    
+    switch (value) {
+            
+        case PROF_OTHER:    return "Other";
+        case PROF_VIC:      return "VICII";
+        case PROF_CIA1:     return "CIA 1";
+        case PROF_CIA2:     return "CIA 2";
+        case PROF_CPU:      return "CPU";
+        case PROF_DRIVE:    return "Drive";
+        case PROF_SID:      return "SID";
+        case PROF_ENDFRAME: return "End of frame";
+        case PROF_IDLE:     return "Idle";
+        default:            return "???";
+    }
+}
+
 //
 // Structures
 //
@@ -192,6 +233,84 @@ typedef struct
 }
 C64ConfigurationDeprecated;
 
+typedef struct
+{
+    // Number of frames that have been synchronized with the host clock
+    u64 frames;
+    
+    // Number of times the synchronization timer has been restarted
+    u64 resyncs;
+    
+    // Overshoot of the most recent wake-up in nanoseconds
+    i64 jitter;
+    
+    // Minimum, maximum, and average overshoot in nanoseconds
+    i64 minJitter;
+    i64 maxJitter;
+    i64 avgJitter;
+}
+TimingInfo;
+
+typedef struct
+{
+    // Number of the most recently profiled frame
+    u64 frame;
+    
+    // Number of profiled frames since the statistics have been cleared
+    u64 frames;
+    
+    // Host ticks spent in each component during the most recent frame
+    u64 ticks[PROF_COUNT];
+    
+    // Percentage of each component in the most recent frame
+    double share[PROF_COUNT];
+    
+    // Host ticks spent in each component since the statistics were cleared
+    u64 accumulated[PROF_COUNT];
+}
+ProfileInfo;
+
+typedef struct
+{
+    // Number of emulated frames
+    u64 frames;
+    
+    // Host time spent emulating the instance in nanoseconds
+    u64 nanos;
+    
+    // Number of emulated slices and the number of slices run by a thief
+    u64 slices;
+    u64 steals;
+    
+    // Emulated frames per second of host time
+    double fps;
+    
+    // Worker thread that emulated the most recent slice
+    long worker;
+    
+    // Indicates that the instance has stopped (a run loop flag is set)
+    bool halted;
+}
+FarmInstanceInfo;
+
+typedef struct
+{
+    // Frame in which the information has been recorded
+    u64 frame;
+    
+    // Inspected component (only the corresponding entries are valid)
+    InspectionTarget target;
+    
+    CPUInfo cpu;
+    MemInfo mem;
+    CIAInfo cia[2];
+    VICIIInfo vic;
+    SpriteInfo sprite[8];
+    SIDInfo sid;
+    VoiceInfo voice[3];
+}
+InspectionInfo;
+
 // Configurations of standard C64 models
 static const C64ConfigurationDeprecated configurations[] = {
     
@@ -566,6 +566,7 @@ CIA::sleep()
     wakeUpCycle = sleep;
     tiredness = 0;
     sleeping = true;
+    c64.scheduleAbs(slot, wakeUpCycle);
 }
 
 void
@@ -583,6 +584,7 @@ CIA::wakeUp(Cycle targetCycle)
         
     // Calculate the number of missed cycles
     wakeUpCycle = targetCycle;
+    c64.scheduleAbs(slot, wakeUpCycle);
     Cycle missedCycles = wakeUpCycle - sleepCycle;
     
     // Make up for missed cycles
@@ -617,6 +619,7 @@ CIA::idleSince()
 CIA1::CIA1(C64 &ref) : CIA(ref)
 {
     setDescription("CIA1");
+    slot = SLOT_CIA1;
 }
 
 void 
@@ -744,6 +747,7 @@ CIA1::updatePB()
 CIA2::CIA2(C64 &ref) : CIA(ref)
 {
     setDescription("CIA2");
+    slot = SLOT_CIA2;
 }
 
 void
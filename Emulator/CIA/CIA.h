@@ -223,6 +223,9 @@ public:
      * The variable is set in sleep()
      */
     Cycle wakeUpCycle;
+
+    // The event slot used to schedule the execution of this CIA
+    EventSlot slot;
     
     
     //
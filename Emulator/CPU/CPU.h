@@ -397,13 +397,20 @@ public:
     // Returns true if the next cycle marks the beginning of an instruction
     bool inFetchPhase() { return next == fetch; }
 
-    // Executes the next micro instruction
-    void executeOneCycle();
+    // Returns true if the CPU checks for breakpoints
+    bool inDebugMode() { return debugMode; }
+    
+    /* Executes the next micro instruction. The template parameter determines
+     * if the debug mode checks are compiled in. The C64 CPU is executed with
+     * the parameter matching the current value of debugMode. The drive CPUs
+     * are always executed with debug checks disabled.
+     */
+    template <bool dbg> void executeOneCycle();
 
 private:
 
     // Called after the last microcycle has been completed
-    void done();
+    template <bool dbg> void done();
 };
 
 
@@ -14,9 +14,9 @@
 //
 
 bool
-Guard::eval(u32 addr)
+Guard::eval(u32 addr, GuardAccess access)
 {
-    if (this->addr == addr && this->enabled) {
+    if (covers(addr, access) && this->enabled) {
         if (++hits > skip) {
             return true;
         }
@@ -77,9 +77,9 @@ Guards::isSetAndConditionalAt(u32 addr)
 }
 
 void
-Guards::addAt(u32 addr, long skip)
+Guards::addRangeAt(u32 first, u32 last, GuardAccess access, long skip)
 {
-    if (isSetAt(addr)) return;
+    if (isSetAt(first) || last < first) return;
 
     if (count >= capacity) {
 
@@ -90,11 +90,14 @@ Guards::addAt(u32 addr, long skip)
         capacity *= 2;
     }
 
-    guards[count].addr = addr;
+    guards[count].addr = first;
+    guards[count].last = last;
+    guards[count].access = access;
     guards[count].enabled = true;
     guards[count].hits = 0;
     guards[count].skip = skip;
     count++;
+    updateMaps();
     setNeedsCheck(true);
 }
 
@@ -116,6 +119,7 @@ Guards::removeAt(u32 addr)
             break;
         }
     }
+    updateMaps();
     setNeedsCheck(count != 0);
 }
 
@@ -124,8 +128,11 @@ Guards::replace(long nr, u32 addr)
 {
     if (nr >= count || isSetAt(addr)) return;
     
+    // Move the observed range to the new start address
+    guards[nr].last = addr + (guards[nr].last - guards[nr].addr);
     guards[nr].addr = addr;
     guards[nr].hits = 0;
+    updateMaps();
 }
 
 bool
@@ -138,6 +145,7 @@ void
 Guards::setEnable(long nr, bool val)
 {
     if (nr < count) guards[nr].enabled = val;
+    updateMaps();
 }
 
 void
@@ -145,13 +153,42 @@ Guards::setEnableAt(u32 addr, bool value)
 {
     Guard *guard = guardAtAddr(addr);
     if (guard) guard->enabled = value;
+    updateMaps();
+}
+
+void
+Guards::updateMaps()
+{
+    memset(readMap, 0, sizeof(readMap));
+    memset(writeMap, 0, sizeof(writeMap));
+    
+    for (int i = 0; i < count; i++) {
+        
+        if (!guards[i].enabled) continue;
+        
+        if (guards[i].access & GUARD_READ)
+            mark(readMap, guards[i].addr, guards[i].last);
+        if (guards[i].access & GUARD_WRITE)
+            mark(writeMap, guards[i].addr, guards[i].last);
+    }
+}
+
+void
+Guards::mark(u64 *map, u32 first, u32 last)
+{
+    if (first > 0xFFFF) return;
+    if (last > 0xFFFF) last = 0xFFFF;
+    
+    for (u32 addr = first; addr <= last; addr++) {
+        map[addr >> 6] |= 1ULL << (addr & 63);
+    }
 }
 
 bool
-Guards::eval(u32 addr)
+Guards::match(u32 addr, GuardAccess access)
 {
     for (int i = 0; i < count; i++)
-        if (guards[i].eval(addr)) return true;
+        if (guards[i].eval(addr, access)) return true;
 
     return false;
 }
@@ -159,17 +196,19 @@ Guards::eval(u32 addr)
 void
 Breakpoints::setNeedsCheck(bool value)
 {
-    if (value || cpu.c64.inDebugMode()) {
+    if (value || cpu.c64.inDebugMode() || cpu.debugger.isRecording()) {
         cpu.debugMode = true;
     } else {
         cpu.debugMode = false;
     }
+    cpu.c64.requestRunLoopUpdate();
 }
 
 void
 Watchpoints::setNeedsCheck(bool value)
 {
-    cpu.c64.mem.checkWatchpoints = value;
+    // The page table is updated by the emulator thread (if running)
+    cpu.c64.requestRunLoopUpdate();
 }
 
 //
@@ -186,6 +225,7 @@ CPUDebugger::registerInstruction(u8 opcode, const char *mnemonic, AddressingMode
 {
     this->mnemonic[opcode] = mnemonic;
     this->addressingMode[opcode] = mode;
+    recorder.setInstructionLength(opcode, getLengthOfInstruction(opcode));
 }
 
 void
@@ -196,6 +236,12 @@ CPUDebugger::_powerOn()
 #endif
 }
 
+void
+CPUDebugger::_powerOff()
+{
+    stopRecording();
+}
+
 void
 CPUDebugger::_reset()
 {
@@ -226,13 +272,13 @@ CPUDebugger::breakpointMatches(u32 addr)
         return true;
     }
 
-    return breakpoints.eval(addr);
+    return breakpoints.eval(addr, GUARD_READ);
 }
 
 bool
-CPUDebugger::watchpointMatches(u32 addr)
+CPUDebugger::watchpointMatches(u32 addr, GuardAccess access)
 {
-    return watchpoints.eval(addr);
+    return watchpoints.eval(addr, access);
 }
 
 int
@@ -260,6 +306,51 @@ CPUDebugger::logInstruction()
     logBuffer[i].x = cpu.reg.x;
     logBuffer[i].y = cpu.reg.y;
     logBuffer[i].flags = cpu.getP();
+    
+    // Stream the instruction to the trace file
+    if (recorder.isRecording()) recorder.record(logBuffer[i]);
+}
+
+bool
+CPUDebugger::startRecording(const char *path)
+{
+    suspend();
+    bool result = recorder.startRecording(path);
+    breakpoints.setNeedsCheck(breakpoints.elements() != 0);
+    resume();
+    
+    return result;
+}
+
+void
+CPUDebugger::stopRecording()
+{
+    if (!recorder.isRecording()) return;
+    
+    suspend();
+    recorder.stopRecording();
+    breakpoints.setNeedsCheck(breakpoints.elements() != 0);
+    resume();
+}
+
+bool
+CPUDebugger::disassembleTrace(const char *path, u64 first, u64 count, FILE *out)
+{
+    TraceReader reader;
+    RecordedInstruction instr;
+    
+    if (!reader.open(path) || !reader.skip(first)) return false;
+    
+    for (u64 i = 0; i < count && reader.read(instr); i++) {
+        
+        fprintf(out, "%10llu  %s: ", (unsigned long long)instr.cycle, disassembleAddr(instr.pc));
+        fprintf(out, "%-10s ", disassembleBytes(instr));
+        fprintf(out, "%-12s ", disassembleInstr(instr, NULL));
+        fprintf(out, "A=%02X X=%02X Y=%02X SP=%02X %s\n",
+                instr.a, instr.x, instr.y, instr.sp, disassembleRecordedFlags(instr));
+    }
+    
+    return true;
 }
 
 RecordedInstruction &
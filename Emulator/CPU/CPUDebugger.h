@@ -11,12 +11,17 @@
 #define _CPU_DEBUGGER_H
 
 #include "C64Component.h"
+#include "TraceRecorder.h"
 
 // Base structure for a single breakpoint or watchpoint
 struct Guard {
     
-    // The observed address
+    // The observed address range (first == last for a single address)
     u32 addr;
+    u32 last;
+    
+    // The observed access types
+    GuardAccess access;
     
     // Disabled guards never trigger
     bool enabled;
@@ -29,8 +34,13 @@ struct Guard {
     
 public:
     
+    // Returns true if the guard covers the provided address and access type
+    bool covers(u32 addr, GuardAccess access) {
+        return addr >= this->addr && addr <= last && (this->access & access);
+    }
+    
     // Returns true if the guard hits
-    bool eval(u32 addr);
+    bool eval(u32 addr, GuardAccess access);
 };
 
 // Base class for a collection of guards
@@ -56,6 +66,15 @@ protected:
     // Number of currently stored guards
     long count = 0;
 
+    /* Presence bitmaps. Each bit corresponds to a memory address and is set
+     * if at least one enabled guard observes the address for the specified
+     * access type. The bitmaps are derived from the guards array in
+     * updateMaps() which keeps the per-access cost independent of the number
+     * of guards. The guards array is only consulted if a bit is set.
+     */
+    u64 readMap[1024];
+    u64 writeMap[1024];
+
     // Indicates if guard checking is necessary
     virtual void setNeedsCheck(bool value) = 0;
     
@@ -66,7 +85,7 @@ protected:
     
 public:
     
-    Guards(CPU<C64Memory>& ref) : cpu(ref) { }
+    Guards(CPU<C64Memory>& ref) : cpu(ref) { updateMaps(); }
     
     
     //
@@ -78,6 +97,8 @@ public:
     Guard *guardAtAddr(u32 addr);
     
     u32 guardAddr(long nr) { return nr < count ? guards[nr].addr : 0; }
+    u32 guardLast(long nr) { return nr < count ? guards[nr].last : 0; }
+    GuardAccess guardAccess(long nr) { return nr < count ? guards[nr].access : GUARD_RW; }
     
     bool isSetAt(u32 addr);
     bool isSetAndEnabledAt(u32 addr);
@@ -88,11 +109,12 @@ public:
     // Adding or removing guards
     //
     
-    void addAt(u32 addr, long skip = 0);
+    void addAt(u32 addr, long skip = 0) { addRangeAt(addr, addr, GUARD_RW, skip); }
+    void addRangeAt(u32 first, u32 last, GuardAccess access = GUARD_RW, long skip = 0);
     void removeAt(u32 addr);
     
     void remove(long nr);
-    void removeAll() { count = 0; setNeedsCheck(false); }
+    void removeAll() { count = 0; updateMaps(); setNeedsCheck(false); }
     
     void replace(long nr, u32 addr);
     
@@ -117,9 +139,26 @@ public:
     
 private:
     
-    bool eval(u32 addr);
+    // Rebuilds the presence bitmaps from the guards array
+    void updateMaps();
+    
+    // Marks an address range in a presence bitmap
+    void mark(u64 *map, u32 first, u32 last);
+    
+    // Scans the guards array for a guard that hits
+    bool match(u32 addr, GuardAccess access);
+    
+public:
+    
+    // Returns true if a guard hits for the provided address and access type
+    bool eval(u32 addr, GuardAccess access) {
+        u64 *map = access == GUARD_WRITE ? writeMap : readMap;
+        if (likely(!(map[(addr >> 6) & 0x3FF] & (1ULL << (addr & 63))))) return false;
+        return match(addr, access);
+    }
 };
 
+// Breakpoints are checked against the read map when an instruction is fetched
 class Breakpoints : public Guards {
     
 public:
@@ -154,9 +193,12 @@ public:
     // Breakpoint storage
     Breakpoints breakpoints = Breakpoints(cpu);
 
-    // Watchpoint storage (not yet supported)
+    // Watchpoint storage
     Watchpoints watchpoints = Watchpoints(cpu);
     
+    // Streams executed instructions to a trace file
+    TraceRecorder recorder;
+    
 private:
     
     /* Number of logged instructions.
@@ -192,6 +234,9 @@ public:
 
     // Initializes an entry of the lookup tables
     void registerInstruction(u8 opcode, const char *mnemonic, AddressingMode mode);
+    
+    // Returns the addressing mode of an opcode
+    AddressingMode getAddressingMode(u8 opcode) { return addressingMode[opcode]; }
 
 private:
     
@@ -226,6 +271,7 @@ private:
 private:
     
     void _powerOn() override;
+    void _powerOff() override;
 
 
     //
@@ -242,7 +288,7 @@ public:
     bool breakpointMatches(u32 addr);
 
     // Returns true if a watchpoint hits at the provides address
-    bool watchpointMatches(u32 addr);
+    bool watchpointMatches(u32 addr, GuardAccess access);
     
     
     //
@@ -268,6 +314,25 @@ public:
     // Clears the log buffer
     void clearLog() { logCnt = 0; }
     
+    
+    //
+    // Working with trace files
+    //
+    
+    /* Starts or stops streaming all executed instructions to a trace file.
+     * While a recording is in progress, the CPU runs in debug mode.
+     */
+    bool startRecording(const char *path);
+    void stopRecording();
+    bool isRecording() { return recorder.isRecording(); }
+    
+    /* Disassembles a range of instructions from a trace file. Each line shows
+     * the cycle, the program counter, the instruction bytes, the disassembled
+     * instruction, and the register contents before the instruction was
+     * executed. Returns false if the file cannot be read.
+     */
+    bool disassembleTrace(const char *path, u64 first, u64 count, FILE *out);
+    
     //
     // Examining instructions
     //
@@ -300,8 +365,7 @@ public:
     const char *disassembleDataBytes();
     const char *disassemblePC();
 
-private:
-    
+    // Disassembles a recorded instruction
     const char *disassembleInstr(RecordedInstruction &instr, long *len);
     const char *disassembleBytes(RecordedInstruction &instr);
     const char *disassembleRecordedFlags(RecordedInstruction &instr);
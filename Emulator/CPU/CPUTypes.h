@@ -83,6 +83,14 @@ typedef enum
 }
 Breakpoint;
 
+typedef enum : u8
+{
+    GUARD_READ  = 0x01,
+    GUARD_WRITE = 0x02,
+    GUARD_RW    = 0x03
+}
+GuardAccess;
+
 //
 // Structures
 //
@@ -0,0 +1,312 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#include "C64.h"
+#include <sched.h>
+#include <time.h>
+
+// Encodes an instruction relative to its predecessor
+static long
+encodeRecord(u8 *buffer, const RecordedInstruction &instr, u8 length,
+             const RecordedInstruction &prev, u8 prevLength)
+{
+    u8 *ptr = buffer + 1;
+    u8 header = (u8)(length << 1);
+
+    // Elapsed cycles
+    u64 delta = instr.cycle - prev.cycle;
+    do {
+        *ptr++ = (delta & 0x7F) | (delta > 0x7F ? 0x80 : 0x00);
+        delta >>= 7;
+    } while (delta);
+
+    // Program counter (omitted if the instruction follows its predecessor)
+    if (prevLength == 0 || instr.pc != (u16)(prev.pc + prevLength)) {
+        header |= TRC_PC;
+        *ptr++ = LO_BYTE(instr.pc);
+        *ptr++ = HI_BYTE(instr.pc);
+    }
+
+    // Instruction bytes
+    *ptr++ = instr.byte1;
+    if (length > 1) *ptr++ = instr.byte2;
+    if (length > 2) *ptr++ = instr.byte3;
+
+    // Registers
+    if (instr.a != prev.a) { header |= TRC_A; *ptr++ = instr.a; }
+    if (instr.x != prev.x) { header |= TRC_X; *ptr++ = instr.x; }
+    if (instr.y != prev.y) { header |= TRC_Y; *ptr++ = instr.y; }
+    if (instr.sp != prev.sp) { header |= TRC_SP; *ptr++ = instr.sp; }
+    if (instr.flags != prev.flags) { header |= TRC_P; *ptr++ = instr.flags; }
+
+    buffer[0] = header;
+    return ptr - buffer;
+}
+
+//
+// TraceRecorder
+//
+
+TraceRecorder::TraceRecorder()
+{
+    setDescription("TraceRecorder");
+    
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&wakeUp, NULL);
+    
+    for (unsigned i = 0; i < 256; i++) lengths[i] = 1;
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stopRecording();
+    delete queue;
+    
+    pthread_cond_destroy(&wakeUp);
+    pthread_mutex_destroy(&lock);
+}
+
+bool
+TraceRecorder::startRecording(const char *path)
+{
+    assert(path != NULL);
+
+    stopRecording();
+
+    if (!(file = fopen(path, "wb"))) {
+        warn("Failed to create trace file %s\n", path);
+        return false;
+    }
+
+    fwrite(traceSignature, 1, sizeof(traceSignature), file);
+    fwrite(&traceVersion, 1, 1, file);
+
+    if (!queue) queue = new SPSCQueue<RecordedInstruction, queueCapacity>();
+    queue->clear();
+    count = 0;
+    stalls = 0;
+    terminate = false;
+
+    if (pthread_create(&writer, NULL, writerMain, (void *)this) != 0) {
+        warn("Failed to launch the trace writer thread\n");
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    recording = true;
+    msg("Recording trace to %s\n", path);
+    return true;
+}
+
+void
+TraceRecorder::stopRecording()
+{
+    if (!recording) return;
+
+    // Let the writer thread drain the queue and terminate
+    terminate = true;
+    wakeUpWriter();
+    pthread_join(writer, NULL);
+
+    fclose(file);
+    file = NULL;
+    recording = false;
+
+    msg("Recorded %llu instructions (%llu stalls)\n", count, stalls);
+}
+
+void
+TraceRecorder::recordSlow(const RecordedInstruction &instr)
+{
+    stalls++;
+    wakeUpWriter();
+    
+    while (!queue->write(instr)) {
+        
+        // Drop the instruction if the writer thread is shutting down
+        if (terminate) return;
+        sched_yield();
+    }
+}
+
+void
+TraceRecorder::wakeUpWriter()
+{
+    pthread_mutex_lock(&lock);
+    sleeping = false;
+    pthread_cond_signal(&wakeUp);
+    pthread_mutex_unlock(&lock);
+}
+
+void *
+TraceRecorder::writerMain(void *recorder)
+{
+    ((TraceRecorder *)recorder)->drain();
+    return NULL;
+}
+
+void
+TraceRecorder::drain()
+{
+    static const long bufferSize = 64 * 1024;
+    u8 *buffer = new u8[bufferSize];
+    long fill = 0;
+
+    // The previously encoded instruction (length 0 = none)
+    RecordedInstruction prev, instr;
+    memset(&prev, 0, sizeof(prev));
+    u8 prevLength = 0;
+
+    while (true) {
+
+        // Read the termination flag before draining to not miss any element
+        bool last = terminate;
+
+        while (queue->read(instr)) {
+
+            u8 length = lengths[instr.byte1];
+            fill += encodeRecord(buffer + fill, instr, length, prev, prevLength);
+            prev = instr;
+            prevLength = length;
+
+            if (fill > bufferSize - maxTraceRecordSize) {
+                fwrite(buffer, 1, fill, file);
+                fill = 0;
+            }
+        }
+
+        if (last) break;
+
+        // Sleep until enough instructions are queued (or 100 msec have passed)
+        struct timespec timeout;
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_nsec += 100000000;
+        if (timeout.tv_nsec >= 1000000000) { timeout.tv_sec++; timeout.tv_nsec -= 1000000000; }
+
+        pthread_mutex_lock(&lock);
+        sleeping = true;
+        while (sleeping && !terminate && queue->count() < wakeUpThreshold) {
+            if (pthread_cond_timedwait(&wakeUp, &lock, &timeout) != 0) break;
+        }
+        sleeping = false;
+        pthread_mutex_unlock(&lock);
+    }
+
+    fwrite(buffer, 1, fill, file);
+    delete [] buffer;
+}
+
+//
+// TraceReader
+//
+
+TraceReader::TraceReader()
+{
+    setDescription("TraceReader");
+}
+
+TraceReader::~TraceReader()
+{
+    close();
+}
+
+bool
+TraceReader::open(const char *path)
+{
+    assert(path != NULL);
+
+    close();
+
+    if (!(file = fopen(path, "rb"))) {
+        warn("Failed to open trace file %s\n", path);
+        return false;
+    }
+
+    char signature[sizeof(traceSignature)];
+    u8 version;
+
+    if (fread(signature, 1, sizeof(signature), file) != sizeof(signature) ||
+        fread(&version, 1, 1, file) != 1 ||
+        memcmp(signature, traceSignature, sizeof(signature)) != 0 ||
+        version != traceVersion) {
+
+        warn("%s is not a valid trace file\n", path);
+        close();
+        return false;
+    }
+
+    memset(&current, 0, sizeof(current));
+    length = 0;
+    index = 0;
+    return true;
+}
+
+void
+TraceReader::close()
+{
+    if (file) fclose(file);
+    file = NULL;
+}
+
+bool
+TraceReader::read(RecordedInstruction &instr)
+{
+    if (!file) return false;
+
+    int header = getc(file);
+    if (header == EOF) return false;
+
+    // Elapsed cycles
+    u64 delta = 0;
+    for (int shift = 0, byte = 0x80; byte & 0x80; shift += 7) {
+        if ((byte = getc(file)) == EOF) return false;
+        delta |= (u64)(byte & 0x7F) << shift;
+    }
+    current.cycle += delta;
+
+    // Program counter
+    if (header & TRC_PC) {
+        u8 lo = (u8)getc(file);
+        u8 hi = (u8)getc(file);
+        current.pc = LO_HI(lo, hi);
+    } else {
+        current.pc += length;
+    }
+
+    // Instruction bytes
+    length = (header >> 1) & 0x03;
+    current.byte1 = (u8)getc(file);
+    current.byte2 = length > 1 ? (u8)getc(file) : 0;
+    current.byte3 = length > 2 ? (u8)getc(file) : 0;
+
+    // Registers
+    if (header & TRC_A) current.a = (u8)getc(file);
+    if (header & TRC_X) current.x = (u8)getc(file);
+    if (header & TRC_Y) current.y = (u8)getc(file);
+    if (header & TRC_SP) current.sp = (u8)getc(file);
+    if (header & TRC_P) current.flags = (u8)getc(file);
+
+    if (feof(file)) return false;
+
+    instr = current;
+    index++;
+    return true;
+}
+
+bool
+TraceReader::skip(u64 num)
+{
+    RecordedInstruction instr;
+
+    for (u64 i = 0; i < num; i++) {
+        if (!read(instr)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,199 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#ifndef _TRACE_RECORDER_H
+#define _TRACE_RECORDER_H
+
+#include "C64Object.h"
+#include "CPUTypes.h"
+#include "SPSCQueue.h"
+
+/* Trace file format
+ *
+ * A trace file starts with the 7 byte signature "VC64TRC" followed by a
+ * version byte. Each executed instruction is stored as a variable-length
+ * record that only contains what has changed since the previous record:
+ *
+ *     Byte 0      : Header
+ *                   Bit 0     : The PC is stored (instruction is not
+ *                               located right after the previous one)
+ *                   Bit 1 - 2 : Instruction length (1, 2, or 3)
+ *                   Bit 3 - 7 : A, X, Y, SP, P differ from the previous
+ *                               record and are stored
+ *     Byte 1 - n  : Elapsed cycles since the previous record (LEB128)
+ *     Optional    : PC (little endian)
+ *     1 - 3 bytes : Instruction bytes
+ *     Optional    : A, X, Y, SP, P (in this order)
+ *
+ * A typical record occupies four to six bytes.
+ */
+static const char traceSignature[7] = { 'V', 'C', '6', '4', 'T', 'R', 'C' };
+static const u8 traceVersion = 1;
+
+static const u8 TRC_PC = 0x01;
+static const u8 TRC_A  = 0x08;
+static const u8 TRC_X  = 0x10;
+static const u8 TRC_Y  = 0x20;
+static const u8 TRC_SP = 0x40;
+static const u8 TRC_P  = 0x80;
+
+// Maximum size of a single encoded record
+static const int maxTraceRecordSize = 1 + 10 + 2 + 3 + 5;
+
+/* Streams recorded instructions to a trace file. The emulator thread hands
+ * over instructions via a lock-free queue. The queue is drained by a writer
+ * thread which encodes the instructions and writes them to disk. Hence, the
+ * emulator thread is never blocked by file I/O unless the queue overflows.
+ *
+ * The writer thread sleeps on a condition variable while the queue is almost
+ * empty. The emulator thread wakes it up once a batch of instructions has
+ * been queued. To make sure the file catches up when the emulator is paused,
+ * the writer thread also wakes up periodically.
+ */
+class TraceRecorder : public C64Object {
+
+    // Number of instructions the queue can hold
+    static const long queueCapacity = 1 << 15;
+
+    // Number of queued instructions that wakes up the writer thread
+    static const long wakeUpThreshold = queueCapacity / 4;
+
+    // Queue connecting the emulator thread with the writer thread
+    SPSCQueue<RecordedInstruction, queueCapacity> *queue = NULL;
+
+    // The trace file
+    FILE *file = NULL;
+
+    // The writer thread
+    pthread_t writer;
+
+    // Used to put the writer thread to sleep and to wake it up
+    pthread_mutex_t lock;
+    pthread_cond_t wakeUp;
+
+    // Indicates that the writer thread is sleeping
+    std::atomic<bool> sleeping { false };
+
+    // Indicates if a recording is in progress
+    std::atomic<bool> recording { false };
+
+    // Signals the writer thread to terminate
+    std::atomic<bool> terminate { false };
+
+    // Number of recorded instructions
+    u64 count = 0;
+
+    // Number of times the emulator thread had to wait for the writer thread
+    u64 stalls = 0;
+
+    // Instruction length of each opcode (needed for encoding)
+    u8 lengths[256];
+
+
+    //
+    // Initializing
+    //
+
+public:
+
+    TraceRecorder();
+    ~TraceRecorder();
+
+    // Registers the length of an instruction
+    void setInstructionLength(u8 opcode, u8 length) { lengths[opcode] = length; }
+
+
+    //
+    // Recording
+    //
+
+public:
+
+    // Starts or stops a recording
+    bool startRecording(const char *path);
+    void stopRecording();
+
+    // Returns true if a recording is in progress
+    bool isRecording() { return recording; }
+
+    // Returns the number of recorded instructions
+    u64 getCount() { return count; }
+
+    // Hands over an instruction to the writer thread
+    void record(const RecordedInstruction &instr) {
+
+        if (!queue->write(instr)) recordSlow(instr);
+        if (sleeping && queue->count() >= wakeUpThreshold) wakeUpWriter();
+        count++;
+    }
+
+private:
+
+    /* Waits until the writer thread has freed up space in the queue. If the
+     * writer thread is about to terminate, the instruction is dropped.
+     */
+    void recordSlow(const RecordedInstruction &instr);
+
+    // Wakes up the writer thread
+    void wakeUpWriter();
+
+    // Entry point of the writer thread
+    static void *writerMain(void *recorder);
+
+    // Drains the queue until a recording is stopped
+    void drain();
+};
+
+/* Reads back a trace file. The reader decodes the records sequentially and
+ * reconstructs a RecordedInstruction for each of them.
+ */
+class TraceReader : public C64Object {
+
+    // The trace file
+    FILE *file = NULL;
+
+    // The most recently decoded instruction and its length
+    RecordedInstruction current;
+    u8 length = 0;
+
+    // Number of decoded instructions
+    u64 index = 0;
+
+
+    //
+    // Initializing
+    //
+
+public:
+
+    TraceReader();
+    ~TraceReader();
+
+
+    //
+    // Reading
+    //
+
+public:
+
+    // Opens or closes a trace file
+    bool open(const char *path);
+    void close();
+
+    // Returns the index of the next instruction to be read
+    u64 position() { return index; }
+
+    // Decodes the next instruction
+    bool read(RecordedInstruction &instr);
+
+    // Skips the specified number of instructions
+    bool skip(u64 num);
+};
+
+#endif
@@ -261,6 +261,7 @@ Cartridge::_load(u8 *buffer)
         externalRam = new u8[ramCapacity];
         for (int i = 0; i < ramCapacity; i++) externalRam[i] = read8(reader.ptr);
     }
+    invalidateLayout();
 
     debug(SNP_DEBUG, "Recreated from %d bytes\n", reader.ptr - buffer);
     return reader.ptr - buffer;
@@ -369,6 +370,10 @@ Cartridge::setRamCapacity(u32 size)
         ramCapacity = size;
         memset(externalRam, 0xFF, size);
     }
+    
+    // The size of the internal state has changed
+    c64.invalidateLayout();
+    invalidateLayout();
 }
 
 u8
@@ -439,6 +444,7 @@ Cartridge::loadChip(unsigned nr, CRTFile *c)
     }
     
     numPackets++;
+    invalidateLayout();
 }
 
 void
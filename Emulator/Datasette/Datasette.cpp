@@ -151,6 +151,8 @@ Datasette::pressPlay()
     nextRisingEdge = length / 2;
     nextFallingEdge = length;
     advanceHead();
+    
+    c64.requestRunLoopUpdate();
 }
 
 void
@@ -159,6 +161,8 @@ Datasette::pressStop()
     debug(TAP_DEBUG, "pressStop\n");
     motor = false;
     playKey = false;
+    
+    c64.requestRunLoopUpdate();
 }
 
 void
@@ -28,6 +28,7 @@ Drive::Drive(DriveID id, C64 &ref) : C64Component(ref), deviceNr(id)
     
     config.connected = false;
     config.switchedOn = true;
+    config.fastCpu = false;
     config.type = DRIVE_VC1541II;
     
     insertionStatus = FULLY_EJECTED;
@@ -51,6 +52,7 @@ Drive::getConfigItem(ConfigOption option)
         case OPT_DRIVE_TYPE:          return config.type;
         case OPT_DRIVE_CONNECT:       return config.connected;
         case OPT_DRIVE_POWER_SWITCH:  return config.switchedOn;
+        case OPT_DRIVE_FAST_CPU:      return config.fastCpu;
             
         default: assert(false);
     }
@@ -113,6 +115,7 @@ Drive::setConfigItem(DriveID id, ConfigOption option, long value)
             bool wasActive = active;
             active = config.connected && config.switchedOn;
             reset();
+            c64.updateRunLoopFunctions();
             resume();
             messageQueue.put(value ? MSG_DRIVE_CONNECT : MSG_DRIVE_DISCONNECT, deviceNr);
             if (wasActive != active)
@@ -130,12 +133,37 @@ Drive::setConfigItem(DriveID id, ConfigOption option, long value)
             bool wasActive = active;
             active = config.connected && config.switchedOn;
             reset();
+            c64.updateRunLoopFunctions();
             resume();
             messageQueue.put(value ? MSG_DRIVE_POWER_ON : MSG_DRIVE_POWER_OFF, deviceNr);
             if (wasActive != active)
                 messageQueue.put(active ? MSG_DRIVE_ACTIVE : MSG_DRIVE_INACTIVE, deviceNr);
             return true;
         }
+        case OPT_DRIVE_FAST_CPU:
+        {
+            if (config.fastCpu == value) {
+                return false;
+            }
+            
+            suspend();
+            
+            // Bring the drive up to date in the old mode
+            catchUp();
+            
+            // Pay back the cycles the CPU is still ahead
+            if (cpuLead) {
+                u64 now = elapsedTime;
+                elapsedTime = nextClock + cpuLead * 10000;
+                executeFast();
+                elapsedTime = now;
+            }
+            assert(cpuLead == 0);
+            
+            config.fastCpu = value;
+            resume();
+            return true;
+        }
         default:
             return false;
     }
@@ -156,16 +184,24 @@ Drive::_dump()
 }
 
 void
-Drive::execute(u64 duration)
+Drive::catchUp()
 {
-    elapsedTime += duration;
-    while (nextClock < elapsedTime || nextCarry < elapsedTime) {
+    // Ignore nested calls triggered by the drive itself via the IEC bus
+    if (catchingUp) return;
+    catchingUp = true;
+    
+    c64.profiler.enter(PROF_DRIVE);
+    
+    // Take the fast path as long as possible
+    if (config.fastCpu) executeFast();
+    
+    while (nextClock < (i64)elapsedTime || nextCarry < (i64)elapsedTime) {
 
         if (nextClock <= nextCarry) {
             
             // Execute CPU and VIAs
             u64 cycle = ++cpu.cycle;
-            cpu.executeOneCycle();
+            cpu.executeOneCycle<false>();
             if (cycle >= via1.wakeUpCycle) via1.execute(); else via1.idleCounter++;
             if (cycle >= via2.wakeUpCycle) via2.execute(); else via2.idleCounter++;
             updateByteReady();
@@ -180,7 +216,120 @@ Drive::execute(u64 duration)
             nextCarry += delayBetweenTwoCarryPulses[zone];
         }
     }
-    assert(nextClock >= elapsedTime && nextCarry >= elapsedTime);
+    assert(nextClock >= (i64)elapsedTime && nextCarry >= (i64)elapsedTime);
+    
+    c64.profiler.leave();
+    catchingUp = false;
+}
+
+void
+Drive::executeFast()
+{
+    while (nextClock < (i64)elapsedTime) {
+        
+        // Execute read/write logic
+        while (nextCarry < nextClock) {
+            if (spinning) executeUF4();
+            nextCarry += delayBetweenTwoCarryPulses[zone];
+        }
+        
+        // Execute CPU
+        u64 cycle = ++cpu.cycle;
+        if (cpuLead) {
+            cpuLead--;
+        } else if (cpu.inFetchPhase() && !nextInstructionAccessesIO() &&
+                   !(spinning && nextInstructionUsesOverflow())) {
+            do { cpu.executeOneCycle<false>(); cpuLead++; } while (!cpu.inFetchPhase());
+            cpuLead--;
+        } else {
+            cpu.executeOneCycle<false>();
+        }
+        
+        // Execute VIAs
+        if (cycle >= via1.wakeUpCycle) via1.execute(); else via1.idleCounter++;
+        if (cycle >= via2.wakeUpCycle) via2.execute(); else via2.idleCounter++;
+        updateByteReady();
+        if (iec.isDirtyDriveSide) iec.updateIecLinesDriveSide();
+        
+        nextClock += 10000;
+    }
+}
+
+bool
+Drive::nextInstructionAccessesIO()
+{
+    u16 pc = cpu.reg.pc;
+    if (mem.isVIAAddr(pc) || mem.isVIAAddr(pc + 2)) return true;
+    
+    u8 opcode = mem.spypeek(pc);
+    u8 lo = mem.spypeek(pc + 1);
+    u8 hi = mem.spypeek(pc + 2);
+    u16 addr = LO_HI(lo, hi);
+    
+    switch (cpu.debugger.getAddressingMode(opcode)) {
+            
+        case ADDR_ABSOLUTE:
+        case ADDR_DIRECT:
+            
+            return mem.isVIAAddr(addr);
+            
+        case ADDR_ABSOLUTE_X:
+            
+            return mem.isVIAAddr(addr) || mem.isVIAAddr(addr + cpu.reg.x);
+            
+        case ADDR_ABSOLUTE_Y:
+            
+            return mem.isVIAAddr(addr) || mem.isVIAAddr(addr + cpu.reg.y);
+            
+        case ADDR_INDIRECT_X:
+        {
+            u8 ptr = lo + cpu.reg.x;
+            return mem.isVIAAddr(LO_HI(mem.spypeek(ptr), mem.spypeek((u8)(ptr + 1))));
+        }
+        case ADDR_INDIRECT_Y:
+        {
+            u16 base = LO_HI(mem.spypeek(lo), mem.spypeek((u8)(lo + 1)));
+            return mem.isVIAAddr(base) || mem.isVIAAddr(base + cpu.reg.y);
+        }
+        case ADDR_INDIRECT:
+        {
+            u16 next = (addr & 0xFF00) | (u8)(lo + 1);
+            return mem.isVIAAddr(addr) || mem.isVIAAddr(LO_HI(mem.spypeek(addr), mem.spypeek(next)));
+        }
+        case ADDR_RELATIVE:
+            
+            return mem.isVIAAddr(pc + 2 + (i8)lo);
+            
+        default:
+            
+            // Zero page, stack, and immediate accesses never hit the VIAs
+            return false;
+    }
+}
+
+bool
+Drive::nextInstructionUsesOverflow()
+{
+    switch (mem.spypeek(cpu.reg.pc)) {
+            
+        case 0x50: case 0x70: case 0xB8:                        // BVC BVS CLV
+        case 0x08: case 0x28: case 0x40:                        // PHP PLP RTI
+        case 0x24: case 0x2C: case 0x6B:                        // BIT ARR
+        case 0x61: case 0x65: case 0x69: case 0x6D:             // ADC
+        case 0x71: case 0x75: case 0x79: case 0x7D:
+        case 0xE1: case 0xE5: case 0xE9: case 0xEB: case 0xED:  // SBC
+        case 0xF1: case 0xF5: case 0xF9: case 0xFD:
+        case 0x63: case 0x67: case 0x6F:                        // RRA
+        case 0x73: case 0x77: case 0x7B: case 0x7F:
+        case 0xE3: case 0xE7: case 0xEF:                        // ISC
+        case 0xF3: case 0xF7: case 0xFB: case 0xFF:
+            
+            return true;
+            
+        default:
+            
+            return false;
+    }
 }
 
 void
@@ -120,6 +120,18 @@ private:
      */
     i64 nextCarry = 0;
     
+    /* Number of clock cycles the CPU is ahead of the other components. In fast
+     * CPU mode, instructions are executed as a whole in their first cycle. In
+     * the remaining cycles of the instruction, only the VIAs are clocked.
+     */
+    u8 cpuLead = 0;
+    
+    // Maximum time the drive may lag behind in fast CPU mode (64 cycles)
+    static const i64 maxLag = 640000;
+    
+    // Indicates that catchUp() is running (prevents nested calls)
+    bool catchingUp = false;
+    
 public:
     
     /* Counts the number of carry pulses from UE7. In a perfect setting, a new
@@ -255,6 +267,7 @@ private:
         & elapsedTime
         & nextClock
         & nextCarry
+        & cpuLead
         & carryCounter
         & counterUF4
         & bitReadyTimer
@@ -350,12 +363,41 @@ public:
 public:
     
     /* Executes all pending cycles of the virtual drive. The number of cycles
-     * is determined by the target time which is elapsedTime + duration.
+     * is determined by the target time which is elapsedTime + duration. In
+     * fast CPU mode, the drive is executed in bursts. Pending cycles are
+     * accumulated until the drive lags behind by more than maxLag or until
+     * catchUp() is called.
+     */
+    void execute(u64 duration) {
+        elapsedTime += duration;
+        if (!config.fastCpu || (i64)elapsedTime - nextClock > maxLag) catchUp();
+    }
+    
+    /* Executes all pending cycles. This function is called whenever the C64
+     * interacts with the drive via the IEC bus.
      */
-    void execute(u64 duration);
+    void catchUp();
 
 private:
     
+    /* Executes the drive in fast CPU mode. In this mode, the CPU executes
+     * whole instructions atomically. It falls back to cycle-exact execution
+     * for all instructions that might access a VIA register. While the disk
+     * is spinning, it also falls back for all instructions that depend on the
+     * V flag, because the byte ready line sets this flag via the SO pin. The
+     * read/write logic keeps running at its own pace in both cases.
+     */
+    void executeFast();
+    
+    /* Checks if the next instruction might access a VIA register. The check
+     * is conservative. It takes dummy accesses into account and treats
+     * instructions fetched from the I/O area as I/O accesses, too.
+     */
+    bool nextInstructionAccessesIO();
+    
+    // Checks if the next instruction reads or modifies the V flag
+    bool nextInstructionUsesOverflow();
+    
     // Emulates a trigger event on the carry output pin of UE7.
     void executeUF4();
     
@@ -61,6 +61,7 @@ typedef struct
     DriveType type;
     bool connected;
     bool switchedOn;
+    bool fastCpu;
 }
 DriveConfig;
 
@@ -137,9 +137,20 @@ IEC::updateIecLines()
 	}
 }
 
+void
+IEC::setNeedsUpdateC64Side()
+{
+    isDirtyC64Side = true;
+    c64.scheduleAbs(SLOT_IEC, cpu.cycle);
+}
+
 void
 IEC::updateIecLinesC64Side()
 {
+    // Catch up with the drives before the bus changes
+    drive8.catchUp();
+    drive9.catchUp();
+    
     // Get bus signals from C64 side
     u8 ciaBits = cia2.getPA();
     ciaAtn = !!(ciaBits & 0x08);
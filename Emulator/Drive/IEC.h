@@ -126,7 +126,7 @@ public:
     
     // Requensts an update of the bus lines from the C64 side
     // DEPRECATED
-    void setNeedsUpdateC64Side() { isDirtyC64Side = true; }
+    void setNeedsUpdateC64Side();
 
     // Requensts an update of the bus lines from the drive side
     // DEPRECATED
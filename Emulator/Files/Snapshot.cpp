@@ -8,6 +8,9 @@
 // -----------------------------------------------------------------------------
 
 #include "C64.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 const u8 Snapshot::magicBytes[] = { 'V', 'C', '6', '4' };
 
@@ -16,7 +19,7 @@ Snapshot::isSnapshot(const u8 *buffer, size_t length)
 {
     assert(buffer != NULL);
     
-    if (length < 0x15) return false;
+    if (length < sizeof(SnapshotHeader)) return false;
     return matchingBufferHeader(buffer, magicBytes, sizeof(magicBytes));
 }
 
@@ -83,10 +86,135 @@ Snapshot::Snapshot()
 
 Snapshot::Snapshot(size_t capacity)
 {
-    size = capacity + sizeof(SnapshotHeader);
+    setDescription("Snapshot");
+    alloc(capacity, 0, 0);
+}
+
+Snapshot::~Snapshot()
+{
+    dealloc();
+}
+
+void
+Snapshot::dealloc()
+{
+    if (!mapped) { AnyFile::dealloc(); return; }
+
+    munmap(data, size);
+    data = NULL;
+    size = 0;
+    fp = -1;
+    eof = -1;
+    mapped = false;
+}
+
+// Appends an entry to the table of contents
+static void
+addChunk(vector<SnapshotChunk> &toc, const char *name, size_t offset, size_t size)
+{
+    SnapshotChunk chunk;
+
+    memset(&chunk, 0, sizeof(chunk));
+    strncpy(chunk.name, name, sizeof(chunk.name) - 1);
+    chunk.offset = (u32)offset;
+    chunk.size = (u32)size;
+    toc.push_back(chunk);
+}
+
+// Appends an entry for a component and its subcomponents
+static void
+addComponentChunks(vector<SnapshotChunk> &toc, HardwareComponent *c,
+                   const char *prefix, size_t stateOffset, int depth)
+{
+    char name[sizeof(SnapshotChunk::name)];
+
+    if (prefix) {
+        snprintf(name, sizeof(name), "%s/%s", prefix, c->getDescription());
+    } else {
+        snprintf(name, sizeof(name), "%s", c->getDescription());
+    }
+    addChunk(toc, name, stateOffset + c->getSnapshotOffset(), c->size());
+
+    if (depth > 1) {
+        for (HardwareComponent *sub : c->subComponents) {
+            addComponentChunks(toc, sub, name, stateOffset, depth - 1);
+        }
+    }
+}
+
+// Collects the installed Roms that are not contained in the Rom database
+static void
+collectUnknownRoms(C64 *c64, vector<pair<const u8 *, size_t>> &roms)
+{
+    if (c64->romIdentifier(ROM_BASIC) == ROM_UNKNOWN && c64->hasRom(ROM_BASIC)) {
+        roms.push_back(pair<const u8 *, size_t>(c64->mem.basicRom, 0x2000));
+    }
+    if (c64->romIdentifier(ROM_CHAR) == ROM_UNKNOWN && c64->hasRom(ROM_CHAR)) {
+        roms.push_back(pair<const u8 *, size_t>(c64->mem.charRom, 0x1000));
+    }
+    if (c64->romIdentifier(ROM_KERNAL) == ROM_UNKNOWN && c64->hasRom(ROM_KERNAL)) {
+        roms.push_back(pair<const u8 *, size_t>(c64->mem.kernalRom, 0x2000));
+    }
+    if (c64->romIdentifier(ROM_VC1541) == ROM_UNKNOWN && c64->hasRom(ROM_VC1541)) {
+        roms.push_back(pair<const u8 *, size_t>(c64->drive8.mem.rom, 0x4000));
+    }
+}
+
+void
+Snapshot::alloc(size_t capacity, u16 width, u16 height, C64 *c64)
+{
+    vector<SnapshotChunk> toc;
+    vector<pair<const u8 *, size_t>> roms;
+
+    // Reserve space for the table of contents
+    size_t numChunks = 2;
+    if (c64) {
+        for (HardwareComponent *c : c64->subComponents) {
+            numChunks += 1 + c->subComponents.size();
+        }
+        collectUnknownRoms(c64, roms);
+        numChunks += roms.size();
+    }
+    size_t offset = sizeof(SnapshotHeader) + numChunks * sizeof(SnapshotChunk);
+
+    // Thumbnail
+    size_t thumbnailSize = sizeof(SnapshotThumbnail) + (size_t)width * height * 4;
+    offset = (offset + 15) & ~15;
+    addChunk(toc, "Thumbnail", offset, thumbnailSize);
+    offset += thumbnailSize;
+
+    // Emulator state
+    offset = (offset + 15) & ~15;
+    addChunk(toc, "C64", offset, capacity);
+    if (c64) {
+        for (HardwareComponent *c : c64->subComponents) {
+            addComponentChunks(toc, c, NULL, offset, 2);
+        }
+    }
+    size_t stateEnd = offset + capacity;
+
+    // Roms which can't be referenced by their hash value
+    size_t end = stateEnd;
+    for (auto &rom : roms) {
+
+        char name[sizeof(SnapshotChunk::name)];
+        snprintf(name, sizeof(name), "Rom/%016llx", (unsigned long long)fnv_1a_64((u8 *)rom.first, rom.second));
+
+        end = (end + 15) & ~15;
+        addChunk(toc, name, end, rom.second);
+        end += rom.second;
+    }
+    assert(toc.size() == numChunks);
+
+    // Allocate memory
+    dealloc();
+    size = end;
     data = new u8[size];
-    
-    SnapshotHeader *header = (SnapshotHeader *)data;
+    memset(data, 0, offset);
+    memset(data + stateEnd, 0, end - stateEnd);
+
+    // Write the header
+    SnapshotHeader *header = getHeader();
     header->magicBytes[0] = magicBytes[0];
     header->magicBytes[1] = magicBytes[1];
     header->magicBytes[2] = magicBytes[2];
@@ -94,7 +222,63 @@ Snapshot::Snapshot(size_t capacity)
     header->major = V_MAJOR;
     header->minor = V_MINOR;
     header->subminor = V_SUBMINOR;
-    header->timestamp = time(NULL);
+    header->numChunks = (u32)numChunks;
+    header->timestamp = (i64)time(NULL);
+
+    // Write the table of contents
+    memcpy(data + sizeof(SnapshotHeader), toc.data(), numChunks * sizeof(SnapshotChunk));
+
+    // Write the thumbnail header
+    SnapshotThumbnail *thumbnail = (SnapshotThumbnail *)(data + getChunk(0)->offset);
+    thumbnail->width = width;
+    thumbnail->height = height;
+
+    // Write the Roms
+    for (size_t i = 0; i < roms.size(); i++) {
+        memcpy(data + getChunk(numChunks - roms.size() + i)->offset, roms[i].first, roms[i].second);
+    }
+}
+
+bool
+Snapshot::isValid(const u8 *buffer, size_t length)
+{
+    if (length < sizeof(SnapshotHeader)) return false;
+
+    SnapshotHeader *header = (SnapshotHeader *)buffer;
+    SnapshotChunk *toc = (SnapshotChunk *)(buffer + sizeof(SnapshotHeader));
+    bool compressed = header->flags & SNP_COMPRESSED;
+
+    // Check the table of contents
+    size_t numChunks = header->numChunks;
+    if (numChunks > (length - sizeof(SnapshotHeader)) / sizeof(SnapshotChunk)) return false;
+    size_t tocEnd = sizeof(SnapshotHeader) + numChunks * sizeof(SnapshotChunk);
+
+    // Chunks refer to the uncompressed layout, which ends with the last chunk
+    size_t end = tocEnd;
+    for (size_t i = 0; i < numChunks; i++) {
+
+        if (memchr(toc[i].name, 0, sizeof(toc[i].name)) == NULL) return false;
+        end = MAX(end, (size_t)toc[i].offset + toc[i].size);
+    }
+    if (end > (compressed ? header->rawSize : length)) return false;
+
+    // Only allocate as much memory for decompressing as the chunks need
+    if (compressed && header->rawSize != end) return false;
+
+    // Check the thumbnail (always stored in the first chunk)
+    if (numChunks == 0) return false;
+    if (strcmp(toc[0].name, "Thumbnail") != 0) return false;
+    if (toc[0].size < sizeof(SnapshotThumbnail)) return false;
+    if (!compressed) {
+        SnapshotThumbnail *thumbnail = (SnapshotThumbnail *)(buffer + toc[0].offset);
+        if (toc[0].size < sizeof(SnapshotThumbnail) + (size_t)thumbnail->width * thumbnail->height * 4) return false;
+    }
+
+    // Check the emulator state
+    for (size_t i = 0; i < numChunks; i++) {
+        if (strcmp(toc[i].name, "C64") == 0) return true;
+    }
+    return false;
 }
 
 Snapshot *
@@ -110,6 +294,75 @@ Snapshot::makeWithBuffer(const u8 *buffer, size_t length)
     return snapshot;
 }
 
+void
+Snapshot::replaceData(u8 *buffer, size_t length)
+{
+    dealloc();
+    data = buffer;
+    size = length;
+    fp = 0;
+    eof = length;
+}
+
+void
+Snapshot::compress()
+{
+    if (isCompressed()) return;
+
+    // Compute the checksums of the uncompressed data
+    seal();
+
+    size_t tocEnd = sizeof(SnapshotHeader) + numChunks() * sizeof(SnapshotChunk);
+    size_t bound = tocEnd + lzCompressBound(size - tocEnd);
+    u8 *buffer = new u8[bound];
+
+    // Keep the header and the table of contents, compress the rest
+    memcpy(buffer, data, tocEnd);
+    size_t length = tocEnd + lzCompress(data + tocEnd, size - tocEnd, buffer + tocEnd);
+
+    SnapshotHeader *header = (SnapshotHeader *)buffer;
+    header->flags |= SNP_COMPRESSED;
+    header->rawSize = (u32)size;
+
+    // Shrink the buffer to its final size
+    u8 *result = new u8[length];
+    memcpy(result, buffer, length);
+    delete [] buffer;
+
+    replaceData(result, length);
+}
+
+bool
+Snapshot::decompress()
+{
+    if (!isCompressed()) return true;
+
+    size_t tocEnd = sizeof(SnapshotHeader) + numChunks() * sizeof(SnapshotChunk);
+    size_t rawSize = getHeader()->rawSize;
+    u8 *buffer = new u8[rawSize];
+
+    memcpy(buffer, data, tocEnd);
+    if (!lzDecompress(data + tocEnd, size - tocEnd, buffer + tocEnd, rawSize - tocEnd)) {
+        warn("Snapshot data is corrupted\n");
+        delete [] buffer;
+        return false;
+    }
+
+    SnapshotHeader *header = (SnapshotHeader *)buffer;
+    header->flags &= ~SNP_COMPRESSED;
+    header->rawSize = 0;
+
+    // Keep the compressed data if the result is corrupted
+    if (!isValid(buffer, rawSize)) {
+        warn("Snapshot data is corrupted\n");
+        delete [] buffer;
+        return false;
+    }
+
+    replaceData(buffer, rawSize);
+    return true;
+}
+
 Snapshot *
 Snapshot::makeWithFile(const char *filename)
 {
@@ -123,12 +376,51 @@ Snapshot::makeWithFile(const char *filename)
     return snapshot;
 }
 
+Snapshot *
+Snapshot::makeWithMappedFile(const char *filename)
+{
+    Snapshot *snapshot;
+    struct stat fileProperties;
+    void *ptr;
+    int fd;
+
+    assert(filename != NULL);
+
+    if (!isSupportedSnapshotFile(filename)) return NULL;
+    if ((fd = open(filename, O_RDONLY)) < 0) return NULL;
+
+    if (fstat(fd, &fileProperties) != 0 || fileProperties.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // Map the file copy-on-write
+    ptr = mmap(NULL, fileProperties.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) return NULL;
+
+    snapshot = new Snapshot();
+    snapshot->data = (u8 *)ptr;
+    snapshot->size = fileProperties.st_size;
+    snapshot->fp = 0;
+    snapshot->eof = fileProperties.st_size;
+    snapshot->mapped = true;
+    snapshot->setPath(filename);
+
+    if (!snapshot->isValid()) {
+        delete snapshot;
+        return NULL;
+    }
+    return snapshot;
+}
+
 Snapshot *
 Snapshot::makeWithC64(C64 *c64)
 {
     Snapshot *snapshot;
     
-    snapshot = new Snapshot(c64->size());
+    snapshot = new Snapshot();
+    snapshot->alloc(c64->size(), VISIBLE_PIXELS, c64->vic.numVisibleRasterlines(), c64);
     
     snapshot->takeScreenshot(c64);
     c64->save(snapshot->getData());
@@ -142,22 +434,145 @@ Snapshot::hasSameType(const char *filename)
     return Snapshot::isSnapshotFile(filename, V_MAJOR, V_MINOR, V_SUBMINOR);
 }
 
+bool
+Snapshot::readFromBuffer(const u8 *buffer, size_t length)
+{
+    if (!isSupportedSnapshot(buffer, length)) return false;
+    if (!AnyFile::readFromBuffer(buffer, length)) return false;
+
+    if (!isValid()) {
+        warn("Snapshot is corrupted\n");
+        dealloc();
+        return false;
+    }
+    return true;
+}
+
+size_t
+Snapshot::writeToBuffer(u8 *buffer)
+{
+    if (buffer) seal();
+    return AnyFile::writeToBuffer(buffer);
+}
+
 void
 Snapshot::takeScreenshot(C64 *c64)
 {
-    SnapshotHeader *header = (SnapshotHeader *)data;
+    SnapshotThumbnail *thumbnail = (SnapshotThumbnail *)chunkData(getChunk(0));
     
     unsigned xStart = FIRST_VISIBLE_PIXEL;
     unsigned yStart = FIRST_VISIBLE_LINE;
-    header->screenshot.width = VISIBLE_PIXELS;
-    header->screenshot.height = c64->vic.numVisibleRasterlines();
+    unsigned width = MIN(thumbnail->width, VISIBLE_PIXELS);
+    unsigned height = MIN(thumbnail->height, c64->vic.numVisibleRasterlines());
     
-    u32 *source = (u32 *)c64->vic.stableEmuTexture();
-    u32 *target = header->screenshot.screen;
-    source += xStart + yStart * TEX_WIDTH;
-    for (unsigned i = 0; i < header->screenshot.height; i++) {
-        memcpy(target, source, header->screenshot.width * 4);
-        target += header->screenshot.width;
-        source += TEX_WIDTH;
+    u32 *target = (u32 *)(thumbnail + 1);
+    
+    // Headless VICIIs provide the frame drawn for the last request (if any)
+    c64->vic.copyLatestFrame(target, thumbnail->width,
+                             xStart, yStart, width, height);
+}
+
+SnapshotChunk *
+Snapshot::getChunk(long nr)
+{
+    assert(nr >= 0 && nr < numChunks());
+    return (SnapshotChunk *)(data + sizeof(SnapshotHeader)) + nr;
+}
+
+SnapshotChunk *
+Snapshot::findChunk(const char *name)
+{
+    assert(name != NULL);
+    
+    for (long i = 0; i < numChunks(); i++) {
+        if (strcmp(getChunk(i)->name, name) == 0) return getChunk(i);
     }
+    return NULL;
+}
+
+void
+Snapshot::seal()
+{
+    if (getHeader()->flags & SNP_CHECKSUMS) return;
+    
+    for (long i = 0; i < numChunks(); i++) {
+        
+        SnapshotChunk *chunk = getChunk(i);
+        chunk->checksum = crc32(chunkData(chunk), chunk->size);
+    }
+    getHeader()->flags |= SNP_CHECKSUMS;
+}
+
+bool
+Snapshot::verify(SnapshotChunk *chunk)
+{
+    assert(chunk != NULL);
+    
+    if (!(getHeader()->flags & SNP_CHECKSUMS)) return true;
+    return crc32(chunkData(chunk), chunk->size) == chunk->checksum;
+}
+
+bool
+Snapshot::verify()
+{
+    if (!decompress()) return false;
+
+    for (long i = 0; i < numChunks(); i++) {
+        if (!verify(getChunk(i))) return false;
+    }
+    return true;
+}
+
+bool
+Snapshot::loadChunk(const char *name, HardwareComponent *component)
+{
+    assert(component != NULL);
+    
+    if (!decompress()) return false;
+    SnapshotChunk *chunk = findChunk(name);
+    
+    if (chunk == NULL) {
+        warn("Snapshot chunk %s not found\n", name);
+        return false;
+    }
+    if (chunk->size != component->size()) {
+        warn("Snapshot chunk %s has an unexpected size\n", name);
+        return false;
+    }
+    if (!verify(chunk)) {
+        warn("Snapshot chunk %s is corrupted\n", name);
+        return false;
+    }
+    
+    component->load(chunkData(chunk));
+    return true;
+}
+
+u8 *
+Snapshot::getData()
+{
+    if (!decompress()) return NULL;
+    SnapshotChunk *chunk = findChunk("C64");
+    return chunk ? chunkData(chunk) : NULL;
+}
+
+unsigned char *
+Snapshot::getImageData()
+{
+    if (!decompress()) return NULL;
+    return chunkData(getChunk(0)) + sizeof(SnapshotThumbnail);
+}
+
+unsigned
+Snapshot::getImageWidth()
+{
+    if (!decompress()) return 0;
+    return ((SnapshotThumbnail *)chunkData(getChunk(0)))->width;
+}
+
+unsigned
+Snapshot::getImageHeight()
+{
+    if (!decompress()) return 0;
+    return ((SnapshotThumbnail *)chunkData(getChunk(0)))->height;
 }
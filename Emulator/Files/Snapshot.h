@@ -12,114 +12,255 @@
 
 #include "AnyFile.h"
 
+/* Snapshot file layout
+ *
+ * A snapshot is a chunked container. It starts with a header, followed by a
+ * table of contents and the chunk data:
+ *
+ *     SnapshotHeader      Signature, version number, number of chunks
+ *     SnapshotChunk[n]    Table of contents
+ *     Chunk data          Thumbnail image and emulator state
+ *
+ * The thumbnail is stored in chunk "Thumbnail". The emulator state is stored
+ * in chunk "C64". Chunks for the components of the C64 refer to the state of
+ * a single component inside the "C64" chunk. Their names reflect the
+ * component hierarchy (e.g., "Drive8" or "Drive8/Disk"). Hence, chunks may
+ * overlap. Each chunk can be loaded into its component on its own.
+ *
+ * The emulator state doesn't contain the Roms. It only refers to them by
+ * their FNV-64 hash (see RomStore). Roms that are not contained in the Rom
+ * database are stored in additional chunks named "Rom/<hash>".
+ *
+ * The checksums in the table of contents are computed when the snapshot is
+ * written to a buffer or file. This keeps taking a snapshot cheap.
+ *
+ * A snapshot can be compressed. In a compressed snapshot, everything behind
+ * the table of contents is replaced by the compressed data (see lzCompress).
+ * The header and the table of contents remain readable and keep referring to
+ * the uncompressed layout. Accessing the thumbnail or the emulator state
+ * decompresses the snapshot automatically.
+ */
 typedef struct {
-    
+
     // Header signature
     char magicBytes[4];
-    
+
     // Version number
     u8 major;
     u8 minor;
     u8 subminor;
-    
-    // Thumbnail image
-    struct {
-        u16 width, height;
-        u32 screen[TEX_HEIGHT * TEX_WIDTH];
-        
-    } screenshot;
-    
+
+    // Snapshot flags
+    u8 flags;
+
+    // Number of entries in the table of contents
+    u32 numChunks;
+
+    // Size of the uncompressed snapshot (compressed snapshots only)
+    u32 rawSize;
+
     // Creation date
-    time_t timestamp;
+    i64 timestamp;
 }
 SnapshotHeader;
 
+// Snapshot flags
+static const u8 SNP_CHECKSUMS  = 0x01; // The checksums are valid
+static const u8 SNP_COMPRESSED = 0x02; // The chunk data is compressed
+
+typedef struct {
+
+    // Name of the chunk (zero terminated)
+    char name[32];
+
+    // Location of the chunk data relative to the beginning of the snapshot
+    u32 offset;
+    u32 size;
+
+    // CRC-32 checksum of the chunk data
+    u32 checksum;
+    u32 reserved;
+}
+SnapshotChunk;
+
+// Header of the thumbnail chunk (followed by width * height RGBA pixels)
+typedef struct {
+
+    u16 width;
+    u16 height;
+    u32 reserved;
+}
+SnapshotThumbnail;
+
 class Snapshot : public AnyFile {
-    
+
     // Header signature
     static const u8 magicBytes[];
-    
-    
+
+    // Indicates if the data is a memory mapped snapshot file
+    bool mapped = false;
+
+
     //
     // Class methods
     //
-    
+
 public:
-    
+
     // Checks whether a buffer contains a snapshot
     static bool isSnapshot(const u8 *buffer, size_t length);
-    
+
     // Checks whether a buffer contains a snapshot of a specific version
     static bool isSnapshot(const u8 *buffer, size_t length,
                            u8 major, u8 minor, u8 subminor);
-    
+
     // Checks whether a buffer contains a snapshot with a supported version number
     static bool isSupportedSnapshot(const u8 *buffer, size_t length);
-    
+
     // Checks whether a buffer contains a snapshot with an outdated version number
     static bool isUnsupportedSnapshot(const u8 *buffer, size_t length);
-    
+
     // Checks whether 'path' points to a snapshot
     static bool isSnapshotFile(const char *path);
-    
+
     // Checks whether 'path' points to a snapshot of a specific version
     static bool isSnapshotFile(const char *path, u8 major, u8 minor, u8 subminor);
-    
+
     // Checks whether 'path' points to a snapshot with a supported version number
     static bool isSupportedSnapshotFile(const char *path);
-    
+
     // Checks whether 'path' points to a snapshot with an outdated version number
     static bool isUnsupportedSnapshotFile(const char *path);
-    
-    
+
+
     //
     // Factory methods
     //
-    
+
 public:
-    
+
     static Snapshot *makeWithFile(const char *filename);
     static Snapshot *makeWithBuffer(const u8 *buffer, size_t size);
     static Snapshot *makeWithC64(class C64 *c64);
 
-    
+    /* Maps a snapshot file into memory instead of reading it. Only the pages
+     * that are actually accessed are read from disk. Modifications of a mapped
+     * snapshot are private and never written back to the file.
+     */
+    static Snapshot *makeWithMappedFile(const char *filename);
+
+
     //
     // Initializing
     //
-        
+
     Snapshot();
     Snapshot(size_t capacity);
-    
+    ~Snapshot();
+
+    void dealloc() override;
+
     void takeScreenshot(class C64 *c64);
 
 private:
-    
-    // Allocates memory for storing the emulator state
-    bool setCapacity(size_t size);
-        
-    
+
+    /* Allocates a snapshot with a thumbnail of the specified size and an
+     * emulator state of the specified size. If a C64 is provided, the table
+     * of contents contains a chunk for each component.
+     */
+    void alloc(size_t capacity, u16 width, u16 height, class C64 *c64 = NULL);
+
+    /* Checks the integrity of the table of contents. In a compressed
+     * snapshot, the size of the uncompressed data has to match the chunk
+     * layout. This bounds the memory allocated by decompress().
+     */
+    bool isValid() { return isValid(data, size); }
+    static bool isValid(const u8 *buffer, size_t length);
+
+    // Replaces the snapshot data by a new buffer
+    void replaceData(u8 *buffer, size_t length);
+
+
+    //
+    // Compressing
+    //
+
+public:
+
+    bool isCompressed() { return getHeader()->flags & SNP_COMPRESSED; }
+
+    /* Compresses or decompresses the snapshot. Compressing a snapshot computes
+     * the checksums first. Hence, the checksums always refer to the
+     * uncompressed data. The functions do nothing if the snapshot is already
+     * in the requested state. decompress() returns false if the compressed
+     * data is corrupted.
+     */
+    void compress();
+    bool decompress();
+
+
     //
     // Methods from AnyC64File
     //
-    
+
+public:
+
     FileType type() override { return FILETYPE_V64; }
     bool hasSameType(const char *filename) override;
-    
-    
+    bool readFromBuffer(const u8 *buffer, size_t length) override;
+    size_t writeToBuffer(u8 *buffer) override;
+
+
+    //
+    // Accessing chunks
+    //
+
+public:
+
+    // Returns the number of chunks
+    long numChunks() { return getHeader()->numChunks; }
+
+    // Returns a chunk from the table of contents
+    SnapshotChunk *getChunk(long nr);
+
+    // Returns the chunk with the specified name or NULL if it does not exist
+    SnapshotChunk *findChunk(const char *name);
+
+    // Returns a pointer to the chunk data (snapshot must not be compressed)
+    u8 *chunkData(SnapshotChunk *chunk) {
+        assert(!isCompressed()); return data + chunk->offset; }
+
+    // Computes the checksums of all chunks
+    void seal();
+
+    /* Compares the data of a chunk with its checksum. If no checksums have
+     * been computed yet, the function returns true. The snapshot must not be
+     * compressed when checking a single chunk.
+     */
+    bool verify(SnapshotChunk *chunk);
+    bool verify();
+
+    /* Loads a single chunk into the specified component. The function fails if
+     * the chunk does not exist, does not match the size of the component, or
+     * is corrupted. Note that other components are not informed about the
+     * change of state.
+     */
+    bool loadChunk(const char *name, class HardwareComponent *component);
+
+
     //
     // Accessing properties
     //
-    
+
 public:
-    
+
     SnapshotHeader *getHeader() { return (SnapshotHeader *)data; }
-    u8 *getData() { return data + sizeof(SnapshotHeader); }
-    
-    time_t getTimestamp() { return getHeader()->timestamp; }
-    unsigned char *getImageData() { return (unsigned char *)(getHeader()->screenshot.screen); }
-    unsigned getImageWidth() { return getHeader()->screenshot.width; }
-    unsigned getImageHeight() { return getHeader()->screenshot.height; }
+    u8 *getData();
+
+    time_t getTimestamp() { return (time_t)getHeader()->timestamp; }
+    unsigned char *getImageData();
+    unsigned getImageWidth();
+    unsigned getImageHeight();
 };
 
 #endif
-
@@ -70,13 +70,36 @@ HardwareComponent::configure(DriveID id, ConfigOption option, long value)
 size_t
 HardwareComponent::size()
 {
-    size_t result = _size();
+    if (!layoutIsValid) updateLayout(snapshotOffset);
+    
+    return snapshotSize;
+}
 
+size_t
+HardwareComponent::updateLayout(size_t offset)
+{
+    snapshotOffset = offset;
+    
+    // Subcomponents come first
     for (HardwareComponent *c : subComponents) {
-        result += c->size();
+        offset += c->updateLayout(offset);
     }
+    
+    // The internal state of this component comes last
+    snapshotSize = offset - snapshotOffset + _size();
+    layoutIsValid = true;
+    
+    return snapshotSize;
+}
 
-    return result;
+void
+HardwareComponent::invalidateLayout()
+{
+    layoutIsValid = false;
+    
+    for (HardwareComponent *c : subComponents) {
+        c->invalidateLayout();
+    }
 }
 
 size_t
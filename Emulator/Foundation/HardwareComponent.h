@@ -50,6 +50,18 @@ protected:
      */
     bool debugMode = false;
     
+    /* Snapshot layout. When a snapshot is taken, the subcomponents are saved
+     * first, followed by the internal state of the component. To avoid
+     * recomputing the state size over and over again, the size of each
+     * component is cached together with its offset inside the snapshot of the
+     * top-level component. The layout is computed on demand. It has to be
+     * invalidated whenever the size of a component changes, e.g., when a
+     * cartridge is attached or detached.
+     */
+    size_t snapshotOffset = 0;
+    size_t snapshotSize = 0;
+    bool layoutIsValid = false;
+    
     
     //
     // Initializing
@@ -111,7 +123,8 @@ public:
      * Note: Because this function accesses the internal emulator state with
      * many non-atomic operations, it must not be called on a running emulator.
      * To carry out inspections while the emulator is running, set up an
-     * inspection target via Amiga::setInspectionTarget().
+     * inspection target via C64::setInspectionTarget() and fetch the results
+     * published by the emulator thread (see C64::setInspectionRate()).
      */
     void inspect();
     virtual void _inspect() { }
@@ -143,6 +156,22 @@ public:
     size_t size();
     virtual size_t _size() = 0;
     
+    /* Returns the offset of the internal state inside the snapshot of the
+     * top-level component. The value is only meaningful if the layout of the
+     * top-level component is up to date, i.e., after calling size() on it.
+     * Together with size(), it allows to save or load a single component
+     * in place.
+     */
+    size_t getSnapshotOffset() { return snapshotOffset; }
+    
+    /* Computes the snapshot layout of the component and its subcomponents,
+     * starting at the specified offset. Returns the size of the state.
+     */
+    size_t updateLayout(size_t offset);
+    
+    // Discards the cached snapshot layout of the component and its subcomponents
+    virtual void invalidateLayout();
+    
     // Loads the internal state from a memory buffer
     size_t load(u8 *buffer);
     virtual size_t _load(u8 *buffer) = 0;
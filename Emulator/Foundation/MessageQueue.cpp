@@ -12,27 +12,53 @@
 MessageQueue::MessageQueue()
 {
     setDescription("MessageQueue");
+    
+    pthread_mutex_init(&wakeLock, NULL);
+    pthread_cond_init(&wakeCondition, NULL);
+}
+
+MessageQueue::~MessageQueue()
+{
+    if (launched) {
+        
+        pthread_mutex_lock(&wakeLock);
+        terminate = true;
+        pthread_cond_signal(&wakeCondition);
+        pthread_mutex_unlock(&wakeLock);
+        
+        pthread_join(thread, NULL);
+    }
+    
+    pthread_cond_destroy(&wakeCondition);
+    pthread_mutex_destroy(&wakeLock);
 }
 
 void
 MessageQueue::addListener(const void *listener, Callback *func)
 {
     synchronized {
+        
         listeners.insert(pair <const void *, Callback *> (listener, func));
+        hasListeners = true;
+        
+        // Launch the delivery thread on first use
+        if (!launched) {
+            launched = pthread_create(&thread, NULL, deliveryMain, (void *)this) == 0;
+            if (!launched) warn("Failed to launch the message delivery thread\n");
+        }
     }
     
     // Distribute all pending messages
-    Message msg;
-    while ((msg = get()).type != MSG_NONE) {
-        propagate(&msg);
-    }
+    wakeUp();
 }
 
 void
 MessageQueue::removeListener(const void *listener)
 {
+    // Blocks while the delivery thread is inside a callback
     synchronized {
         listeners.erase(listener);
+        hasListeners = !listeners.empty();
     }
 }
 
@@ -41,51 +67,175 @@ MessageQueue::get()
 { 
 	Message result;
 
-    synchronized {
+    if (!polled.pop(result)) {
+        result.type = MSG_NONE; // Queue is empty
+        result.data = 0;
+    }
+
+    return result;
+}
+
+void
+MessageQueue::put(MessageType type, u64 data)
+{
+    if (!polled.push(type, data)) {
+        debug(MSG_DEBUG, "Queue overflow. Oldest polled message is lost.\n");
+    }
+    if (!delivered.push(type, data)) {
+        debug(MSG_DEBUG, "Queue overflow. Oldest delivered message is lost.\n");
+    }
+    
+    // Serve registered callbacks
+    if (hasListeners) wakeUp();
+}
+
+MessageQueue::Ring::Ring()
+{
+    static_assert((capacity & (capacity - 1)) == 0, "Capacity must be a power of two");
+    
+    // Make all slots ready to be written in the first round
+    for (long i = 0; i < capacity; i++) {
+        slot[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool
+MessageQueue::Ring::push(MessageType type, u64 data)
+{
+    long pos = w.load(std::memory_order_relaxed);
+    Slot *s;
+    bool overflow = false;
+    
+    // Claim a slot
+    while (1) {
+        
+        s = &slot[pos & (capacity - 1)];
+        long diff = s->seq.load(std::memory_order_acquire) - pos;
         
-        // Read message
-        if (r == w) {
-            result.type = MSG_NONE; // Queue is empty
-            result.data = 0;
+        if (diff == 0) {
+            
+            // The slot is free. Try to claim it.
+            if (w.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            
+        } else if (diff < 0) {
+            
+            // The buffer is full. Drop the oldest message.
+            Message lost;
+            pop(lost);
+            overflow = true;
+            pos = w.load(std::memory_order_relaxed);
+            
         } else {
-            result = queue[r];
-            r = (r + 1) % capacity;
+            
+            // Another writer has claimed the slot
+            pos = w.load(std::memory_order_relaxed);
         }
     }
+    
+    // Write data and publish the slot
+    s->msg.type = type;
+    s->msg.data = (long)data;
+    s->seq.store(pos + 1, std::memory_order_release);
+    
+    return !overflow;
+}
 
-    return result;
+bool
+MessageQueue::Ring::pop(Message &msg)
+{
+    long pos = r.load(std::memory_order_relaxed);
+    Slot *s;
+    
+    // Claim a slot
+    while (1) {
+        
+        s = &slot[pos & (capacity - 1)];
+        long diff = s->seq.load(std::memory_order_acquire) - (pos + 1);
+        
+        if (diff == 0) {
+            
+            // The slot has been written. Try to claim it.
+            if (r.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            
+        } else if (diff < 0) {
+            
+            // The buffer is empty
+            return false;
+            
+        } else {
+            
+            // Another reader has claimed the slot
+            pos = r.load(std::memory_order_relaxed);
+        }
+    }
+    
+    // Read data and make the slot ready to be written in the next round
+    msg = s->msg;
+    s->seq.store(pos + capacity, std::memory_order_release);
+    return true;
+}
+
+bool
+MessageQueue::Ring::isEmpty()
+{
+    long pos = r.load(std::memory_order_relaxed);
+    return slot[pos & (capacity - 1)].seq.load(std::memory_order_acquire) != pos + 1;
 }
 
 void
-MessageQueue::put(MessageType type, u64 data)
+MessageQueue::wakeUp()
 {
-    synchronized {
+    // Pairs with the fence in deliver()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    
+    if (sleeping.load(std::memory_order_relaxed)) {
         
-        // Write data
-        Message msg;
-        msg.type = type;
-        msg.data = data;
-        queue[w] = msg;
+        pthread_mutex_lock(&wakeLock);
+        pthread_cond_signal(&wakeCondition);
+        pthread_mutex_unlock(&wakeLock);
+    }
+}
+
+void *
+MessageQueue::deliveryMain(void *queue)
+{
+    ((MessageQueue *)queue)->deliver();
+    return NULL;
+}
+
+void
+MessageQueue::deliver()
+{
+    while (1) {
         
-        // Move write pointer to next location
-        w = (w + 1) % capacity;
+        // Deliver all pending messages
+        Message msg;
+        while (hasListeners && delivered.pop(msg)) propagate(&msg);
         
-        if (w == r) {
-            debug(MSG_DEBUG, "Queue overflow. Oldest message is lost.\n");
-            r = (r + 1) % capacity;
+        // Go to sleep until new messages arrive
+        pthread_mutex_lock(&wakeLock);
+        sleeping = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!terminate && (!hasListeners || delivered.isEmpty())) {
+            pthread_cond_wait(&wakeCondition, &wakeLock);
         }
+        sleeping = false;
+        bool quit = terminate;
+        pthread_mutex_unlock(&wakeLock);
         
-        // Serve registered callbacks
-        propagate(&msg);
+        if (quit) break;
     }
 }
 
 void
 MessageQueue::propagate(Message *msg)
 {
-    map <const void *, Callback *> :: iterator i;
-    
-    for (i = listeners.begin(); i != listeners.end(); i++) {
-        i->second(i->first, msg->type, msg->data);
+    synchronized {
+        
+        map <const void *, Callback *> :: iterator i;
+        
+        for (i = listeners.begin(); i != listeners.end(); i++) {
+            i->second(i->first, msg->type, msg->data);
+        }
     }
 }
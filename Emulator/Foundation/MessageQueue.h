@@ -13,42 +13,116 @@
 #include "C64Object.h"
 #include "C64Types.h"
 #include <map>
+#include <atomic>
 
 using namespace std;
 
+/* Lock-free message queue. Messages can be written by any thread and never
+ * block the writer. They can be polled with get() and are delivered to the
+ * registered listeners by a separate delivery thread. Hence, a slow listener
+ * never stalls the emulator thread. The delivery thread is launched when the
+ * first listener is registered. It delivers the messages in the order they
+ * were written. As long as no listener is registered, messages are kept in
+ * the queue until the first listener shows up.
+ *
+ * Polling and delivery are independent of each other. Each message is stored
+ * in two ring buffers, one drained by get() and one drained by the delivery
+ * thread. Hence, a GUI polling the queue sees every message, no matter if
+ * listeners are registered or not.
+ */
 class MessageQueue : public C64Object {
         
-    // Maximum number of queued messages
-    const static size_t capacity = 64;
+    // Maximum number of queued messages (must be a power of two)
+    const static long capacity = 256;
     
-     // Ring buffer storing all pending messages
-    Message queue[capacity];
-    
-    // The ring buffer's read and write pointers
-    int r = 0;
-    int w = 0;
+    /* A bounded ring buffer. Each slot carries a sequence number telling
+     * whether the slot is ready to be written or to be read in the current
+     * round. Writers and readers claim a slot by advancing the write or read
+     * counter with a CAS operation. If the buffer is full, the oldest message
+     * is dropped.
+     */
+    struct Ring {
+        
+        // A single slot of the ring buffer
+        struct Slot {
+            std::atomic<long> seq;
+            Message msg;
+        };
+        
+        // Ring buffer storing all pending messages
+        Slot slot[capacity];
+        
+        // The ring buffer's read and write counters
+        alignas(64) std::atomic<long> r { 0 };
+        alignas(64) std::atomic<long> w { 0 };
         
-    // List of all registered listeners
+        Ring();
+        
+        // Appends a message. Returns false if the oldest message was dropped.
+        bool push(MessageType type, u64 data);
+        
+        // Removes the oldest message. Returns false if the buffer is empty.
+        bool pop(Message &msg);
+        
+        // Checks if a message is ready to be read
+        bool isEmpty();
+    };
+    
+    // Messages waiting to be polled with get()
+    Ring polled;
+    
+    // Messages waiting to be delivered to the registered listeners
+    Ring delivered;
+    
+    // List of all registered listeners (protected by 'synchronized')
     map <const void *, Callback *> listeners;
+    std::atomic<bool> hasListeners { false };
+    
+    // The delivery thread
+    pthread_t thread;
+    bool launched = false;
+    
+    /* Wakes up the delivery thread. The lock is only held by the delivery
+     * thread while it goes to sleep and by a writer that finds the thread
+     * sleeping. It is never held while a listener is called.
+     */
+    pthread_mutex_t wakeLock;
+    pthread_cond_t wakeCondition;
+    std::atomic<bool> sleeping { false };
+    bool terminate = false;
     
 public:
     
     MessageQueue();
+    ~MessageQueue();
     
     // Registers a listener together with it's callback function
     void addListener(const void *listener, Callback *func);
     
-    // Unregisters a listener
+    /* Unregisters a listener. When the function returns, the callback is
+     * guaranteed not to be running or to be called again.
+     */
     void removeListener(const void *listener);
     
-    // Returns the next pending message, or NULL if the queue is empty
+    /* Returns the next pending message, or MSG_NONE if the queue is empty.
+     * Polling does not remove messages from the listeners' queue.
+     */
     Message get();
     
-    // Writes a message into the queue and propagates it to all listeners
+    // Writes a message into the queue (never blocks)
     void put(MessageType type, u64 data = 0);
     
 private:
     
+    // Wakes up the delivery thread if it is sleeping
+    void wakeUp();
+    
+    // Entry point of the delivery thread
+    static void *deliveryMain(void *queue);
+    
+    // Delivers messages until the queue is destroyed
+    void deliver();
+    
     // Propagates a single message to all registered listeners
     void propagate(Message *msg);
 };
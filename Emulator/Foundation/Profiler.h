@@ -0,0 +1,133 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include "C64Config.h"
+#include "C64Types.h"
+#include "Utils.h"
+
+#if C64_PROFILING && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+/* Measures the host time spent in the emulated components. The profiler keeps
+ * track of the currently executing component and charges the elapsed ticks
+ * to it whenever the emulator enters or leaves a component. Nested calls are
+ * handled by a small stack. Hence, the recorded values are exclusive times
+ * which add up to the total time of a frame.
+ *
+ * If C64_PROFILING is 0, all functions are empty and compiled out.
+ */
+class Profiler {
+    
+    // Ticks collected in the current frame
+    u64 ticks[PROF_COUNT];
+    
+    // Stack of interrupted components
+    ProfiledComponent stack[8];
+    int sp = 0;
+    
+    // The currently executing component
+    ProfiledComponent current = PROF_OTHER;
+    
+    // Time stamp of the latest component switch
+    u64 last = 0;
+    
+    
+    //
+    // Initializing
+    //
+    
+public:
+    
+    Profiler() {
+        
+        memset(ticks, 0, sizeof(ticks));
+#if C64_PROFILING
+        last = now();
+#endif
+    }
+    
+    
+    //
+    // Measuring
+    //
+    
+public:
+    
+    // Reads the host time stamp counter
+    static u64 now() {
+        
+#if C64_PROFILING && (defined(__x86_64__) || defined(__i386__))
+        return __rdtsc();
+#elif C64_PROFILING && defined(__aarch64__)
+        u64 value;
+        asm volatile("mrs %0, cntvct_el0" : "=r" (value));
+        return value;
+#else
+        return monotonicNanos();
+#endif
+    }
+    
+    // Charges the elapsed time to the current component and switches to a new one
+    void enter(ProfiledComponent component) {
+        
+#if C64_PROFILING
+        u64 stamp = now();
+        ticks[current] += stamp - last;
+        last = stamp;
+        
+        assert(sp < 8);
+        stack[sp++] = current;
+        current = component;
+#endif
+    }
+    
+    // Charges the elapsed time to the current component and returns to the previous one
+    void leave() {
+        
+#if C64_PROFILING
+        u64 stamp = now();
+        ticks[current] += stamp - last;
+        last = stamp;
+        
+        assert(sp > 0);
+        current = stack[--sp];
+#endif
+    }
+    
+    /* Completes a frame. The ticks collected so far are added to the provided
+     * info structure and the frame counters are reset.
+     */
+    void endFrame(ProfileInfo &info, u64 frame) {
+        
+#if C64_PROFILING
+        u64 stamp = now();
+        ticks[current] += stamp - last;
+        last = stamp;
+        
+        u64 total = 0;
+        for (int i = 0; i < PROF_COUNT; i++) total += ticks[i];
+        
+        info.frame = frame;
+        info.frames++;
+        for (int i = 0; i < PROF_COUNT; i++) {
+            
+            info.ticks[i] = ticks[i];
+            info.share[i] = total ? 100.0 * ticks[i] / total : 0.0;
+            info.accumulated[i] += ticks[i];
+            ticks[i] = 0;
+        }
+#endif
+    }
+};
+
+#endif
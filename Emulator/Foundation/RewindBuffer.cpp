@@ -0,0 +1,234 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#include "C64.h"
+
+RewindBuffer::RewindBuffer()
+{
+    setDescription("RewindBuffer");
+}
+
+RewindBuffer::~RewindBuffer()
+{
+    setCapacity(0);
+}
+
+void
+RewindBuffer::setCapacity(size_t bytes)
+{
+    clear();
+
+    delete [] ring;
+    ring = NULL;
+    capacity = 0;
+    budget = bytes;
+}
+
+void
+RewindBuffer::clear()
+{
+    delete [] keyframe;
+    delete [] scratch;
+    delete [] delta;
+    keyframe = scratch = delta = NULL;
+
+    deltas.clear();
+    numDeltas = 0;
+    stateSize = 0;
+    head = 0;
+}
+
+size_t
+RewindBuffer::usedBytes()
+{
+    size_t result = 0;
+    for (auto &d : deltas) result += d.size;
+    return result;
+}
+
+void
+RewindBuffer::capture(C64 &c64)
+{
+    if (!budget) return;
+
+    size_t size = c64.size();
+
+    // Start over with a new keyframe if the state layout has changed
+    if (size != stateSize) {
+
+        clear();
+        stateSize = size;
+        if (allocate(size)) c64.save(keyframe);
+        return;
+    }
+    
+    // Check if the budget is large enough to record anything
+    if (!keyframe) return;
+
+    // Take the new state and compute how to get back to the old one
+    c64.save(scratch);
+    size_t deltaSize = computeDelta(keyframe, scratch, delta);
+
+    // Store the delta and make the new state the keyframe
+    if (reserve(deltaSize)) {
+
+        memcpy(ring + head, delta, deltaSize);
+        deltas.push_back(Delta { head, deltaSize });
+        head += deltaSize;
+
+    } else {
+
+        // The delta is too large for the ring
+        deltas.clear();
+        head = 0;
+    }
+    swap(keyframe, scratch);
+    numDeltas = (long)deltas.size();
+}
+
+bool
+RewindBuffer::rewind(C64 &c64, long n)
+{
+    if (n <= 0 || n > frames()) return false;
+
+    // Walk back in time
+    for (long i = 0; i < n; i++) {
+
+        Delta d = deltas.back();
+        applyDelta(keyframe, ring + d.offset, d.size);
+        deltas.pop_back();
+        head = d.offset;
+    }
+    numDeltas = (long)deltas.size();
+
+    // Restore the emulator state
+    c64.load(keyframe);
+    
+    // Clear the keyboard matrix to avoid constantly pressed keys
+    c64.keyboard.releaseAll();
+    
+    // Inform the GUI
+    c64.messageQueue.put(MSG_SNAPSHOT_RESTORED);
+
+    return true;
+}
+
+size_t
+RewindBuffer::computeDelta(const u8 *oldState, const u8 *newState, u8 *buffer)
+{
+    const u64 *o = (const u64 *)oldState;
+    const u64 *n = (const u64 *)newState;
+    size_t words = stateSize / 8;
+    u8 *ptr = buffer;
+
+    for (size_t i = 0; i < words;) {
+
+        // Skip unchanged blocks quickly
+        size_t chunk = MIN(words - i, 32);
+        if (memcmp(o + i, n + i, chunk * 8) == 0) { i += chunk; continue; }
+        while (o[i] == n[i]) i++;
+
+        // Extend the run until two consecutive words match again
+        size_t start = i;
+        while (i < words && (o[i] != n[i] || (i + 1 < words && o[i + 1] != n[i + 1]))) i++;
+
+        u32 offset = (u32)(start * 8);
+        u32 length = (u32)((i - start) * 8);
+        memcpy(ptr, &offset, 4);
+        memcpy(ptr + 4, &length, 4);
+        memcpy(ptr + 8, oldState + offset, length);
+        ptr += 8 + length;
+    }
+
+    // Compare the remaining bytes
+    for (size_t i = words * 8; i < stateSize; i++) {
+
+        if (oldState[i] == newState[i]) continue;
+
+        u32 offset = (u32)i;
+        u32 length = 1;
+        memcpy(ptr, &offset, 4);
+        memcpy(ptr + 4, &length, 4);
+        ptr[8] = oldState[i];
+        ptr += 9;
+    }
+
+    return ptr - buffer;
+}
+
+void
+RewindBuffer::applyDelta(u8 *state, const u8 *buffer, size_t size)
+{
+    const u8 *ptr = buffer;
+
+    while (ptr < buffer + size) {
+
+        u32 offset, length;
+        memcpy(&offset, ptr, 4);
+        memcpy(&length, ptr + 4, 4);
+        assert(offset + length <= stateSize);
+        memcpy(state + offset, ptr + 8, length);
+        ptr += 8 + length;
+    }
+}
+
+bool
+RewindBuffer::allocate(size_t size)
+{
+    // A delta can grow larger than the state by its run headers
+    size_t deltaSize = size + size / 8 + 16;
+    size_t fixed = 2 * size + deltaSize;
+    
+    delete [] ring;
+    ring = NULL;
+    capacity = 0;
+    
+    if (budget <= fixed) {
+        
+        warn("Rewind budget too small (%lu bytes needed)\n", (unsigned long)(fixed + 1));
+        return false;
+    }
+    
+    capacity = budget - fixed;
+    ring = new u8[capacity];
+    keyframe = new u8[size];
+    scratch = new u8[size];
+    delta = new u8[deltaSize];
+    
+    return true;
+}
+
+bool
+RewindBuffer::reserve(size_t size)
+{
+    if (size >= capacity) return false;
+
+    while (!deltas.empty()) {
+
+        size_t tail = deltas.front().offset;
+
+        if (head > tail) {
+
+            // Used area is [tail, head). Try the end first, then the start.
+            if (capacity - head >= size) return true;
+            if (tail > size) { head = 0; return true; }
+
+        } else {
+
+            // Used area wraps around. The free area is [head, tail).
+            if (tail - head > size) return true;
+        }
+
+        // Drop the oldest frame
+        deltas.pop_front();
+    }
+
+    head = 0;
+    return true;
+}
@@ -0,0 +1,134 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#ifndef _REWIND_BUFFER_H
+#define _REWIND_BUFFER_H
+
+#include "C64Object.h"
+#include <deque>
+#include <atomic>
+
+/* Stores the recent history of the emulator state for rewinding. At the end
+ * of each frame, the serialized emulator state is compared with the state of
+ * the previous frame. Only the bytes that have changed are stored. The buffer
+ * keeps the most recent state as a full keyframe and a backwards delta for
+ * each older frame. Rewinding by n frames applies the n most recent deltas to
+ * the keyframe. The deltas are kept in a byte ring of fixed size. If the ring
+ * runs full, the oldest deltas are dropped.
+ *
+ * Delta format: A sequence of runs, each consisting of a 32-bit offset, a
+ * 32-bit length, and the original contents of the changed bytes.
+ */
+class RewindBuffer : public C64Object {
+
+    // Location of a single delta inside the ring
+    struct Delta { size_t offset; size_t size; };
+
+    // Memory budget covering the ring, the keyframe, and the scratch buffers
+    size_t budget = 0;
+    
+    // Ring storing the deltas
+    u8 *ring = NULL;
+    size_t capacity = 0;
+
+    // Write position of the next delta
+    size_t head = 0;
+
+    // All stored deltas, ordered from the oldest to the most recent one
+    std::deque<Delta> deltas;
+    
+    /* Number of stored deltas. The value mirrors deltas.size() and can be
+     * read from any thread while the emulator thread records frames.
+     */
+    std::atomic<long> numDeltas { 0 };
+
+    // Serialized emulator state of the most recent frame (keyframe)
+    u8 *keyframe = NULL;
+
+    // Scratch buffers for taking a new state and for computing deltas
+    u8 *scratch = NULL;
+    u8 *delta = NULL;
+
+    // Size of the serialized emulator state (0 = no keyframe taken yet)
+    size_t stateSize = 0;
+
+
+    //
+    // Initializing
+    //
+
+public:
+
+    RewindBuffer();
+    ~RewindBuffer();
+
+    /* Sets the memory budget in bytes. A value of 0 disables the rewind
+     * buffer. The budget covers all memory the buffer allocates. The
+     * keyframe, the scratch buffers, and the delta ring are allocated when
+     * the first frame is captured. The keyframe and the scratch buffers
+     * take a little more than three times the size of the emulator state
+     * (two state copies plus a worst-case delta). The rest of the
+     * budget goes to the ring. If the budget is too small for the keyframe
+     * and the scratch buffers, no frames are recorded.
+     */
+    void setCapacity(size_t bytes);
+
+    // Discards all recorded frames
+    void clear();
+
+
+    //
+    // Analyzing
+    //
+
+public:
+
+    bool isEnabled() { return budget != 0; }
+
+    // Returns the number of frames that can be rewound (thread-safe)
+    long frames() { return numDeltas; }
+
+    // Returns the number of bytes occupied by the stored deltas
+    size_t usedBytes();
+
+
+    //
+    // Recording and rewinding
+    //
+
+public:
+
+    // Records the current state of the emulator (called at the end of a frame)
+    void capture(class C64 &c64);
+
+    /* Restores the state that was recorded the specified number of frames
+     * ago. All younger frames are discarded. Returns false if not enough
+     * frames are available.
+     */
+    bool rewind(class C64 &c64, long n);
+
+private:
+
+    // Computes the backwards delta from newState to oldState
+    size_t computeDelta(const u8 *oldState, const u8 *newState, u8 *buffer);
+
+    // Applies a backwards delta
+    void applyDelta(u8 *state, const u8 *buffer, size_t size);
+
+    /* Allocates the keyframe, the scratch buffers, and the ring for an
+     * emulator state of the specified size. Returns false if the budget is
+     * too small.
+     */
+    bool allocate(size_t size);
+
+    // Reserves space for a delta in the ring, dropping old deltas if needed
+    bool reserve(size_t size);
+};
+
+#endif
@@ -0,0 +1,87 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#ifndef _SPSC_QUEUE_H
+#define _SPSC_QUEUE_H
+
+#include <atomic>
+
+/* Lock-free single-producer single-consumer queue. The queue is a ring buffer
+ * with a fixed capacity which must be a power of two. Exactly one thread may
+ * call write() and exactly one (other) thread may call read(). Both functions
+ * never block. They return false if the queue is full or empty, respectively.
+ */
+template <class T, long capacity> class SPSCQueue {
+
+    static_assert((capacity & (capacity - 1)) == 0, "Capacity must be a power of two");
+
+    // Ring buffer storing the queue elements
+    T elements[capacity];
+
+    /* Read and write counters. Both counters increase monotonically and are
+     * mapped to a buffer position by masking out the upper bits. They are
+     * placed in separate cache lines to avoid false sharing between the
+     * producer and the consumer thread.
+     */
+    alignas(64) std::atomic<long> r { 0 };
+    alignas(64) std::atomic<long> w { 0 };
+
+
+    //
+    // Initializing
+    //
+
+public:
+
+    // Empties the queue (must not be called while other threads are active)
+    void clear() { r = 0; w = 0; }
+
+
+    //
+    // Analyzing
+    //
+
+    // Returns the number of stored elements
+    long count() const { return w.load(std::memory_order_acquire) - r.load(std::memory_order_acquire); }
+
+    // Returns the number of free slots
+    long free() const { return capacity - count(); }
+
+    bool isEmpty() const { return count() == 0; }
+    bool isFull() const { return count() == capacity; }
+
+
+    //
+    // Reading and writing
+    //
+
+    // Appends an element (called by the producer thread only)
+    bool write(const T &element) {
+
+        long wi = w.load(std::memory_order_relaxed);
+        if (wi - r.load(std::memory_order_acquire) == capacity) return false;
+
+        elements[wi & (capacity - 1)] = element;
+        w.store(wi + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Removes the oldest element (called by the consumer thread only)
+    bool read(T &element) {
+
+        long ri = r.load(std::memory_order_relaxed);
+        if (ri == w.load(std::memory_order_acquire)) return false;
+
+        element = elements[ri & (capacity - 1)];
+        r.store(ri + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif
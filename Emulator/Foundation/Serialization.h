@@ -16,6 +16,8 @@
 #include "TimeDelayed.h"
 #include "envelope.h"
 
+#include <type_traits>
+
 //
 // Basic memory buffer I/O
 //
@@ -84,6 +86,59 @@ inline void writeDouble(u8 *& buffer, double value)
     write64(buffer, *((u64 *)(&value)));
 }
 
+//
+// Bulk memory buffer I/O
+//
+
+// Converts an integer from host byte order to big endian and vice versa
+template <class T> inline T swapBytes(T value)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if constexpr (sizeof(T) == 2) return (T)__builtin_bswap16((u16)value);
+    if constexpr (sizeof(T) == 4) return (T)__builtin_bswap32((u32)value);
+    if constexpr (sizeof(T) == 8) return (T)__builtin_bswap64((u64)value);
+#endif
+    return value;
+}
+
+/* Reads or writes an array of integers. Byte arrays are copied as a whole.
+ * Wider integers are stored in big endian format, just like the scalar
+ * functions above do. The swap loops are free of dependencies between
+ * iterations which allows the compiler to vectorize them.
+ */
+template <class T> inline void readArray(u8 *& buffer, T *values, size_t count)
+{
+    if constexpr (sizeof(T) == 1) {
+        memcpy((void *)values, buffer, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            T value;
+            memcpy(&value, buffer + i * sizeof(T), sizeof(T));
+            values[i] = swapBytes(value);
+        }
+    }
+    buffer += count * sizeof(T);
+}
+
+template <class T> inline void writeArray(u8 *& buffer, const T *values, size_t count)
+{
+    if constexpr (sizeof(T) == 1) {
+        memcpy(buffer, (const void *)values, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            T value = swapBytes(values[i]);
+            memcpy(buffer + i * sizeof(T), &value, sizeof(T));
+        }
+    }
+    buffer += count * sizeof(T);
+}
+
+/* Element type of a (possibly multi-dimensional) array. Arrays of integers
+ * are serialized in bulk, all other arrays element by element.
+ */
+template <class T> using ArrayElement = typename std::remove_all_extents<T>::type;
+template <class T> constexpr bool isBulkArray = std::is_integral<ArrayElement<T>>::value;
+
 //
 // Counter (determines the state size)
 //
@@ -148,8 +203,12 @@ public:
     template <class T, size_t N>
     SerCounter& operator&(T (&v)[N])
     {
-        for(size_t i = 0; i < N; ++i) {
-            *this & v[i];
+        if constexpr (isBulkArray<T>) {
+            count += sizeof(v);
+        } else {
+            for(size_t i = 0; i < N; ++i) {
+                *this & v[i];
+            }
         }
         return *this;
     }
@@ -219,8 +278,12 @@ public:
     template <class T, size_t N>
     SerReader& operator&(T (&v)[N])
     {
-        for(size_t i = 0; i < N; ++i) {
-            *this & v[i];
+        if constexpr (isBulkArray<T>) {
+            readArray(ptr, (ArrayElement<T> *)v, sizeof(v) / sizeof(ArrayElement<T>));
+        } else {
+            for(size_t i = 0; i < N; ++i) {
+                *this & v[i];
+            }
         }
         return *this;
     }
@@ -296,8 +359,12 @@ public:
     template <class T, size_t N>
     SerWriter& operator&(T (&v)[N])
     {
-        for(size_t i = 0; i < N; ++i) {
-            *this & v[i];
+        if constexpr (isBulkArray<T>) {
+            writeArray(ptr, (const ArrayElement<T> *)v, sizeof(v) / sizeof(ArrayElement<T>));
+        } else {
+            for(size_t i = 0; i < N; ++i) {
+                *this & v[i];
+            }
         }
         return *this;
     }
@@ -355,8 +422,12 @@ public:
     template <class T, size_t N>
     SerResetter& operator&(T (&v)[N])
     {
-        for(size_t i = 0; i < N; ++i) {
-            *this & v[i];
+        if constexpr (isBulkArray<T>) {
+            memset((void *)v, 0, sizeof(v));
+        } else {
+            for(size_t i = 0; i < N; ++i) {
+                *this & v[i];
+            }
         }
         return *this;
     }
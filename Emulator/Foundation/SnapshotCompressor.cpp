@@ -0,0 +1,130 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#include "C64.h"
+
+SnapshotCompressor::SnapshotCompressor(C64 &ref) : c64(ref)
+{
+    setDescription("SnapshotCompressor");
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&condition, NULL);
+}
+
+SnapshotCompressor::~SnapshotCompressor()
+{
+    if (launched) {
+
+        pthread_mutex_lock(&lock);
+        terminate = true;
+        pthread_cond_broadcast(&condition);
+        pthread_mutex_unlock(&lock);
+
+        pthread_join(worker, NULL);
+    }
+
+    delete pending;
+    delete latest;
+
+    pthread_cond_destroy(&condition);
+    pthread_mutex_destroy(&lock);
+}
+
+void
+SnapshotCompressor::submit(Snapshot *snapshot)
+{
+    assert(snapshot != NULL);
+
+    pthread_mutex_lock(&lock);
+
+    if (!launched) {
+        launched = pthread_create(&worker, NULL, workerMain, (void *)this) == 0;
+    }
+
+    if (launched) {
+
+        // Replace a snapshot the worker hasn't started with yet
+        delete pending;
+        pending = snapshot;
+        pthread_cond_broadcast(&condition);
+        pthread_mutex_unlock(&lock);
+
+    } else {
+
+        // Fall back to compressing in the calling thread
+        warn("Failed to launch the compression thread\n");
+        pthread_mutex_unlock(&lock);
+
+        snapshot->compress();
+        pthread_mutex_lock(&lock);
+        delete latest;
+        latest = snapshot;
+        pthread_mutex_unlock(&lock);
+        c64.putMessage(MSG_AUTO_SNAPSHOT_TAKEN);
+    }
+}
+
+Snapshot *
+SnapshotCompressor::take()
+{
+    pthread_mutex_lock(&lock);
+    Snapshot *result = latest;
+    latest = NULL;
+    pthread_mutex_unlock(&lock);
+
+    return result;
+}
+
+void
+SnapshotCompressor::flush()
+{
+    pthread_mutex_lock(&lock);
+    while (pending || busy) pthread_cond_wait(&condition, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+void *
+SnapshotCompressor::workerMain(void *compressor)
+{
+    ((SnapshotCompressor *)compressor)->work();
+    return NULL;
+}
+
+void
+SnapshotCompressor::work()
+{
+    pthread_mutex_lock(&lock);
+
+    while (true) {
+
+        while (!pending && !terminate) pthread_cond_wait(&condition, &lock);
+        if (!pending) break;
+
+        Snapshot *snapshot = pending;
+        pending = NULL;
+        busy = true;
+        pthread_mutex_unlock(&lock);
+
+        snapshot->compress();
+
+        pthread_mutex_lock(&lock);
+        delete latest;
+        latest = snapshot;
+        pthread_mutex_unlock(&lock);
+
+        c64.putMessage(MSG_AUTO_SNAPSHOT_TAKEN);
+
+        // Report completion after the message has been sent
+        pthread_mutex_lock(&lock);
+        busy = false;
+        pthread_cond_broadcast(&condition);
+    }
+
+    pthread_mutex_unlock(&lock);
+}
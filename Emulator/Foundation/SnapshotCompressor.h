@@ -0,0 +1,82 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#ifndef _SNAPSHOT_COMPRESSOR_H
+#define _SNAPSHOT_COMPRESSOR_H
+
+#include "C64Object.h"
+
+/* Compresses automatically taken snapshots in the background. The emulator
+ * thread only takes an uncompressed snapshot and hands it over. A worker
+ * thread compresses the snapshot and announces it with a
+ * MSG_AUTO_SNAPSHOT_TAKEN message once it is ready. If a new snapshot is
+ * handed over before the worker has started with the previous one, the
+ * previous one is discarded. The worker thread is launched on first use.
+ */
+class SnapshotCompressor : public C64Object {
+
+    // Reference to the emulator (for sending messages)
+    class C64 &c64;
+
+    // The worker thread
+    pthread_t worker;
+    bool launched = false;
+
+    // Protects all variables below
+    pthread_mutex_t lock;
+    pthread_cond_t condition;
+
+    // Snapshot waiting to be compressed
+    class Snapshot *pending = NULL;
+
+    // Most recent compressed snapshot (not yet picked up)
+    class Snapshot *latest = NULL;
+
+    // Indicates if the worker is compressing a snapshot right now
+    bool busy = false;
+
+    // Signals the worker thread to terminate
+    bool terminate = false;
+
+
+    //
+    // Initializing
+    //
+
+public:
+
+    SnapshotCompressor(C64 &ref);
+    ~SnapshotCompressor();
+
+
+    //
+    // Compressing
+    //
+
+public:
+
+    // Hands over a snapshot (the compressor takes ownership)
+    void submit(class Snapshot *snapshot);
+
+    // Returns the most recent compressed snapshot or NULL if there is none
+    class Snapshot *take();
+
+    // Waits until all submitted snapshots have been compressed
+    void flush();
+
+private:
+
+    // Entry point of the worker thread
+    static void *workerMain(void *compressor);
+
+    // Compresses snapshots until the compressor is destroyed
+    void work();
+};
+
+#endif
@@ -0,0 +1,85 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#ifndef _TRIPLE_BUFFER_H
+#define _TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <assert.h>
+
+/* Lock-free triple buffer for handing over data from a producer thread to a
+ * consumer thread. The producer fills the back slot and publishes it. The
+ * consumer picks up the most recently published slot and reads it as the
+ * front slot. The third slot sits in the middle. Publishing and picking up
+ * exchange a slot with the middle slot in a single atomic operation. Hence,
+ * neither side ever blocks, and the consumer always sees a complete copy.
+ * If the producer publishes faster than the consumer picks up, intermediate
+ * slots are overwritten.
+ *
+ * Exactly one thread may call back() and publish() and exactly one (other)
+ * thread may call update() and front().
+ */
+template <class T> class TripleBuffer {
+
+    // Marks a middle slot that hasn't been picked up yet
+    static const int fresh = 4;
+
+    // The three slots
+    T slots[3];
+
+    // Slot owned by the producer
+    int backIndex = 0;
+
+    // Slot owned by the consumer
+    int frontIndex = 1;
+
+    // Slot most recently published by the producer
+    int latestIndex = 2;
+
+    // Slot in the middle (placed in its own cache line)
+    alignas(64) std::atomic<int> middle { 2 };
+
+public:
+
+    // Returns the slot to be filled by the producer
+    T &back() { return slots[backIndex]; }
+
+    // Hands over the back slot to the consumer
+    void publish() {
+        latestIndex = backIndex;
+        backIndex = middle.exchange(backIndex | fresh, std::memory_order_acq_rel) & 3;
+    }
+
+    /* Returns the slot most recently published. The producer doesn't get this
+     * slot back before it publishes again. Until then, it may read the slot
+     * while the consumer might be reading it, too.
+     */
+    const T &latest() { return slots[latestIndex]; }
+
+    /* Picks up the most recently published slot. Returns false if nothing has
+     * been published since the last call. In this case, the front slot stays
+     * the same.
+     */
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & fresh)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    // Returns the slot most recently picked up by the consumer
+    T &front() { return slots[frontIndex]; }
+
+    /* Provides access to all slots regardless of their role. This function
+     * must only be used while neither the producer nor the consumer is
+     * active, e.g., to allocate resources inside the slots.
+     */
+    T &slot(int nr) { assert(nr >= 0 && nr < 3); return slots[nr]; }
+};
+
+#endif
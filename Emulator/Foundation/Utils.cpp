@@ -10,6 +10,7 @@
 #include "Utils.h"
 
 #include <ctype.h>
+#include <errno.h>
 
 bool
 releaseBuild()
@@ -326,24 +327,58 @@ sleepMicrosec(unsigned usec)
 	}
 }
 
+u64
+monotonicNanos()
+{
+#ifdef __APPLE__
+    
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+    
+#else
+    
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+    
+#endif
+}
+
 i64
-sleepUntil(u64 kernelTargetTime, u64 kernelEarlyWakeup)
+sleepUntil(u64 nanoTargetTime, u64 nanoEarlyWakeup)
 {
-    u64 now = mach_absolute_time();
+    u64 now = monotonicNanos();
     i64 jitter;
     
-    if (now > kernelTargetTime)
-        return 0;
+    // Return immediately if the deadline has already passed
+    if (now > nanoTargetTime)
+        return (i64)(now - nanoTargetTime);
     
     // Sleep
-    // printf("Sleeping for %d\n", kernelTargetTime - now);
-    mach_wait_until(kernelTargetTime - kernelEarlyWakeup);
+    if (nanoTargetTime - now > nanoEarlyWakeup) {
+        
+        u64 wakeup = nanoTargetTime - nanoEarlyWakeup;
+        
+#ifdef __APPLE__
+        
+        static mach_timebase_info_data_t timebase;
+        if (timebase.denom == 0) mach_timebase_info(&timebase);
+        mach_wait_until(wakeup * timebase.denom / timebase.numer);
+        
+#else
+        
+        struct timespec ts;
+        ts.tv_sec = (time_t)(wakeup / 1000000000);
+        ts.tv_nsec = (long)(wakeup % 1000000000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) { }
+        
+#endif
+    }
     
     // Count some sheep to increase precision
-    unsigned sheep = 0;
     do {
-        jitter = mach_absolute_time() - kernelTargetTime;
-        sheep++;
+        jitter = (i64)(monotonicNanos() - nanoTargetTime);
     } while (jitter < 0);
     
     return jitter;
@@ -402,3 +437,140 @@ crc32forByte(u32 r)
         r = (r & 1? 0: (u32)0xEDB88320L) ^ r >> 1;
     return r ^ (u32)0xFF000000L;
 }
+
+size_t
+lzCompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// Writes a length value that exceeds the capacity of the token
+static u8 *
+lzWriteLength(u8 *op, size_t length)
+{
+    for (; length >= 255; length -= 255) *op++ = 255;
+    *op++ = (u8)length;
+    return op;
+}
+
+// Reads a length value that exceeds the capacity of the token
+static bool
+lzReadLength(const u8 *&ip, const u8 *end, size_t &length)
+{
+    u8 byte;
+    do {
+        if (ip >= end) return false;
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Writes a record
+static u8 *
+lzWriteRecord(u8 *op, const u8 *literals, size_t numLiterals,
+              size_t offset, size_t matchLength)
+{
+    size_t m = matchLength ? matchLength - 4 : 0;
+    *op++ = (u8)((MIN(numLiterals, 15) << 4) | MIN(m, 15));
+
+    if (numLiterals >= 15) op = lzWriteLength(op, numLiterals - 15);
+    memcpy(op, literals, numLiterals);
+    op += numLiterals;
+
+    if (matchLength) {
+        *op++ = LO_BYTE(offset);
+        *op++ = HI_BYTE(offset);
+        if (m >= 15) op = lzWriteLength(op, m - 15);
+    }
+    return op;
+}
+
+size_t
+lzCompress(const u8 *src, size_t size, u8 *dst)
+{
+    static const int hashBits = 14;
+    static const size_t maxOffset = 0xFFFF;
+
+    // Most recent position of each hashed 4-byte sequence
+    u32 *table = new u32[1 << hashBits]();
+
+    const u8 *ip = src;
+    const u8 *anchor = src;
+    const u8 *end = src + size;
+    u8 *op = dst;
+
+    while (ip + 4 <= end) {
+
+        u32 sequence;
+        memcpy(&sequence, ip, 4);
+        u32 hash = (sequence * 2654435761U) >> (32 - hashBits);
+        const u8 *ref = src + table[hash];
+        table[hash] = (u32)(ip - src);
+
+        if (ref >= ip || (size_t)(ip - ref) > maxOffset || memcmp(ref, ip, 4)) {
+            ip++;
+            continue;
+        }
+
+        // Extend the match as far as possible
+        size_t length = 4;
+        while (ip + length < end && ref[length] == ip[length]) length++;
+
+        op = lzWriteRecord(op, anchor, ip - anchor, ip - ref, length);
+        ip += length;
+        anchor = ip;
+    }
+
+    // Write the remaining bytes as literals
+    op = lzWriteRecord(op, anchor, end - anchor, 0, 0);
+
+    delete [] table;
+    return op - dst;
+}
+
+bool
+lzDecompress(const u8 *src, size_t size, u8 *dst, size_t dstSize)
+{
+    const u8 *ip = src;
+    const u8 *iend = src + size;
+    u8 *op = dst;
+    u8 *oend = dst + dstSize;
+
+    while (ip < iend) {
+
+        u8 token = *ip++;
+
+        // Copy the literals
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && !lzReadLength(ip, iend, numLiterals)) return false;
+        if (numLiterals > (size_t)(iend - ip) || numLiterals > (size_t)(oend - op)) return false;
+        memcpy(op, ip, numLiterals);
+        op += numLiterals;
+        ip += numLiterals;
+
+        // The last record has no back reference
+        if (ip == iend) break;
+
+        // Copy the match
+        if (iend - ip < 2) return false;
+        size_t offset = LO_HI(ip[0], ip[1]);
+        ip += 2;
+        size_t length = token & 0xF;
+        if (length == 15 && !lzReadLength(ip, iend, length)) return false;
+        length += 4;
+        if (offset == 0 || offset > (size_t)(op - dst) || length > (size_t)(oend - op)) return false;
+
+        const u8 *ref = op - offset;
+        if (offset == 1) {
+            memset(op, *ref, length);
+        } else if (offset >= length) {
+            memcpy(op, ref, length);
+        } else {
+            for (size_t i = 0; i < length; i++) op[i] = ref[i];
+        }
+        op += length;
+    }
+
+    return op == oend;
+}
@@ -12,7 +12,6 @@
 
 #include <assert.h>
 #include <limits.h>
-#include <mach/mach_time.h>
 #include <math.h>
 #include <pthread.h>
 #include <stdarg.h>
@@ -22,8 +21,13 @@
 #include <string.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
 #include "C64Config.h"
 #include "C64Constants.h"
 #include "C64Types.h"
@@ -169,13 +173,40 @@ u8 localTimeHour();
 // Puts the current thread to sleep for a certain amount of time
 void sleepMicrosec(unsigned usec);
 
-/* Sleeps until kernel timer reaches kernelTargetTime. To increase timing
+/* Reads the monotonic clock of the native host. The returned value is
+ * measured in nanoseconds and is unaffected by changes of the wall clock. On
+ * macOS, the value is derived from mach_absolute_time(). On all other
+ * platforms, CLOCK_MONOTONIC is used.
+ */
+u64 monotonicNanos();
+
+/* Sleeps until the monotonic clock reaches nanoTargetTime. To increase timing
  * precision, the function wakes up the thread earlier by the amount of
- * kernelEarlyWakeup and waits actively in a delay loop until the deadline is
- * reached. It returns the overshoot time (jitter), measured in kernel time.
+ * nanoEarlyWakeup and waits actively in a delay loop until the deadline is
+ * reached. On platforms other than macOS, the thread is put to sleep with an
+ * absolute-deadline clock_nanosleep() which doesn't accumulate drift. The
+ * function returns the overshoot time (jitter), measured in nanoseconds.
  * Smaller values are better, 0 is best.
  */
-i64 sleepUntil(u64 kernelTargetTime, u64 kernelEarlyWakeup);
+i64 sleepUntil(u64 nanoTargetTime, u64 nanoEarlyWakeup);
+
+
+//
+// Generating random numbers
+//
+
+/* Advances a xorshift32 pseudo random number generator and returns the next
+ * number. The state must not be zero. Unlike rand(), the generator doesn't
+ * rely on global state. Hence, it can be used by multiple emulator instances
+ * running concurrently.
+ */
+inline u32 xorshift32(u32 &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
 
 
 //
@@ -198,4 +229,35 @@ u64 fnv_1a_64(u8 *addr, size_t size);
 u32 crc32(const u8 *addr, size_t size);
 u32 crc32forByte(u32 r);
 
+
+//
+// Compressing data
+//
+
+/* The compressor is a fast byte-oriented LZ77 variant. The compressed data is
+ * a sequence of records, each consisting of a token byte, a number of
+ * literals, and a back reference:
+ *
+ *     Token      : Bit 4 - 7 : Number of literals (15 = extended)
+ *                  Bit 0 - 3 : Match length - 4 (15 = extended)
+ *     Optional   : Extended literal count (sequence of bytes, 255 = continue)
+ *     n bytes    : Literals
+ *     2 bytes    : Match offset (little endian)
+ *     Optional   : Extended match length (sequence of bytes, 255 = continue)
+ *
+ * The last record only contains literals. Long runs of equal bytes are
+ * encoded as matches with offset 1.
+ */
+
+// Returns the maximum size of the compressed data
+size_t lzCompressBound(size_t size);
+
+// Compresses a buffer and returns the size of the compressed data
+size_t lzCompress(const u8 *src, size_t size, u8 *dst);
+
+/* Decompresses a buffer. The function returns false if the compressed data is
+ * corrupted or does not expand to exactly dstSize bytes.
+ */
+bool lzDecompress(const u8 *src, size_t size, u8 *dst, size_t dstSize);
+
 #endif
@@ -9,16 +9,23 @@
 
 #include "C64.h"
 
-#define CHECK_WATCHPOINT(x) \
-if (checkWatchpoints && cpu.debugger.watchpointMatches(x)) { \
+#define CHECK_WATCHPOINT(x, access) \
+if (checkWatchpoints && cpu.debugger.watchpointMatches(x, access)) { \
     c64.signalWatchpoint(); \
 }
+#define CHECK_READ_WATCHPOINT(x) CHECK_WATCHPOINT(x, GUARD_READ)
+#define CHECK_WRITE_WATCHPOINT(x) CHECK_WATCHPOINT(x, GUARD_WRITE)
 
 C64Memory::C64Memory(C64 &ref) : C64Component(ref)
 {	
 	setDescription("C64 memory");
     		
-    memset(rom, 0, sizeof(rom));
+    basicRom = RomStore::acquire(NULL, 0x2000);
+    charRom = RomStore::acquire(NULL, 0x1000);
+    kernalRom = RomStore::acquire(NULL, 0x2000);
+    basicRomFNV = installedBasicFNV = RomStore::fnv(basicRom);
+    charRomFNV = installedCharFNV = RomStore::fnv(charRom);
+    kernalRomFNV = installedKernalFNV = RomStore::fnv(kernalRom);
 
     config.ramPattern = RAM_PATTERN_C64;
     config.debugcart = false;
@@ -98,6 +105,14 @@ C64Memory::C64Memory(C64 &ref) : C64Component(ref)
     for (unsigned i = 0x1; i <= 0xF; i++) {
         peekSrc[i] = pokeTarget[i] = M_RAM;
     }
+    updatePageTable();
+}
+
+C64Memory::~C64Memory()
+{
+    RomStore::release(basicRom);
+    RomStore::release(charRom);
+    RomStore::release(kernalRom);
 }
 
 void
@@ -109,9 +124,36 @@ C64Memory::_reset()
     eraseWithPattern(config.ramPattern);
         
     // Initialize color RAM with random numbers
-    srand(1000);
+    c64.seedRandom(1000);
     for (unsigned i = 0; i < sizeof(colorRam); i++) {
-        colorRam[i] = (rand() & 0xFF);
+        colorRam[i] = (c64.random() & 0xFF);
+    }
+}
+
+size_t
+C64Memory::didLoadFromBuffer(u8 *buffer)
+{
+    // Switch to the Roms the snapshot was taken with
+    restoreRom(basicRom, basicRomFNV, installedBasicFNV, 0x2000);
+    restoreRom(charRom, charRomFNV, installedCharFNV, 0x1000);
+    restoreRom(kernalRom, kernalRomFNV, installedKernalFNV, 0x2000);
+    
+    // Rebuild the page table from the restored lookup tables
+    updatePageTable();
+    return 0;
+}
+
+void
+C64Memory::restoreRom(u8 *&image, u64 &fnv, u64 &installed, size_t size)
+{
+    // Only consult the RomStore if the snapshot refers to a different Rom
+    if (fnv == installed) return;
+    
+    if (RomStore::exchange(image, fnv, size)) {
+        installed = fnv;
+    } else {
+        warn("Rom %016llx is not available. Keeping the current Rom.\n", fnv);
+        fnv = installed;
     }
 }
 
@@ -211,6 +253,41 @@ C64Memory::eraseWithPattern(RamPattern pattern)
     memset(&ram[0x400], 0x01, 40*25);
 }
 
+void
+C64Memory::installRom(RomType type, const u8 *data)
+{
+    u8 **image;
+    u64 *fnv, *installed;
+    size_t size;
+    
+    switch (type) {
+            
+        case ROM_BASIC:
+            image = &basicRom; fnv = &basicRomFNV; installed = &installedBasicFNV;
+            size = 0x2000;
+            break;
+            
+        case ROM_CHAR:
+            image = &charRom; fnv = &charRomFNV; installed = &installedCharFNV;
+            size = 0x1000;
+            break;
+            
+        case ROM_KERNAL:
+            image = &kernalRom; fnv = &kernalRomFNV; installed = &installedKernalFNV;
+            size = 0x2000;
+            break;
+            
+        default: assert(false); return;
+    }
+    
+    u8 *newImage = RomStore::acquire(data, size);
+    RomStore::release(*image);
+    *image = newImage;
+    *fnv = *installed = RomStore::fnv(newImage);
+    
+    updatePageTable();
+}
+
 void 
 C64Memory::updatePeekPokeLookupTables()
 {
@@ -229,12 +306,70 @@ C64Memory::updatePeekPokeLookupTables()
     
     // Call the Cartridge's delegation method
     expansionport.updatePeekPokeLookupTables();
+    
+    // Derive the page table from the final table entries
+    updatePageTable();
+}
+
+void
+C64Memory::updatePageTable()
+{
+    for (unsigned page = 0; page < 256; page++) {
+        
+        u16 addr = page << 8;
+        
+        switch (peekSrc[page >> 4]) {
+                
+            case M_RAM:
+                peekPage[page] = ram + addr;
+                break;
+                
+            case M_BASIC:
+                peekPage[page] = basicRom + (addr & 0x1FFF);
+                break;
+                
+            case M_CHAR:
+                peekPage[page] = charRom + (addr & 0x0FFF);
+                break;
+                
+            case M_KERNAL:
+                peekPage[page] = kernalRom + (addr & 0x1FFF);
+                break;
+                
+            case M_PP:
+                peekPage[page] = page ? ram + addr : NULL;
+                break;
+                
+            default:
+                peekPage[page] = NULL;
+        }
+        
+        switch (pokeTarget[page >> 4]) {
+                
+            case M_RAM:
+            case M_BASIC:
+            case M_CHAR:
+            case M_KERNAL:
+                pokePage[page] = ram + addr;
+                break;
+                
+            case M_PP:
+                pokePage[page] = page ? ram + addr : NULL;
+                break;
+                
+            default:
+                pokePage[page] = NULL;
+        }
+        
+        // Route all accesses through the slow path if watchpoints are set
+        if (checkWatchpoints) peekPage[page] = pokePage[page] = NULL;
+    }
 }
 
 u8
 C64Memory::peek(u16 addr, MemoryType source)
 {
-    CHECK_WATCHPOINT(addr)
+    CHECK_READ_WATCHPOINT(addr)
     
     switch(source) {
         
@@ -242,9 +377,13 @@ C64Memory::peek(u16 addr, MemoryType source)
         return ram[addr];
         
         case M_BASIC:
+        return basicRom[addr & 0x1FFF];
+        
         case M_CHAR:
+        return charRom[addr & 0x0FFF];
+        
         case M_KERNAL:
-        return rom[addr];
+        return kernalRom[addr & 0x1FFF];
         
         case M_IO:
         return peekIO(addr);
@@ -284,7 +423,7 @@ C64Memory::peek(u16 addr, bool gameLine, bool exromLine)
 u8
 C64Memory::peekZP(u8 addr)
 {
-    CHECK_WATCHPOINT(addr)
+    CHECK_READ_WATCHPOINT(addr)
     
     if (likely(addr >= 0x02)) {
         return ram[addr];
@@ -298,7 +437,7 @@ C64Memory::peekZP(u8 addr)
 u8
 C64Memory::peekStack(u8 sp)
 {
-    CHECK_WATCHPOINT(sp)
+    CHECK_READ_WATCHPOINT(0x100 + sp)
     
     return ram[0x100 + sp];
 }
@@ -306,7 +445,7 @@ C64Memory::peekStack(u8 sp)
 u8
 C64Memory::peekIO(u16 addr)
 {
-    CHECK_WATCHPOINT(addr)
+    CHECK_READ_WATCHPOINT(addr)
     
     assert(addr >= 0xD000 && addr <= 0xDFFF);
     
@@ -345,6 +484,11 @@ C64Memory::peekIO(u16 addr)
 	
         case 0xD: // CIA 2
             
+            // Make sure the IEC bus reflects the current drive state
+            if ((addr & 0x000F) == 0x00) {
+                drive8.catchUp();
+                drive9.catchUp();
+            }
             return cia2.peek(addr & 0x000F);
             
         case 0xE: // I/O space 1
@@ -369,9 +513,13 @@ C64Memory::spypeek(u16 addr, MemoryType source)
             return ram[addr];
             
         case M_BASIC:
+            return basicRom[addr & 0x1FFF];
+            
         case M_CHAR:
+            return charRom[addr & 0x0FFF];
+            
         case M_KERNAL:
-            return rom[addr];
+            return kernalRom[addr & 0x1FFF];
             
         case M_IO:
             return spypeekIO(addr);
@@ -447,7 +595,7 @@ C64Memory::spypeekColor(u16 addr)
 void
 C64Memory::poke(u16 addr, u8 value, MemoryType target)
 {
-    CHECK_WATCHPOINT(addr)
+    CHECK_WRITE_WATCHPOINT(addr)
     
     switch(target) {
             
@@ -499,7 +647,7 @@ C64Memory::poke(u16 addr, u8 value, bool gameLine, bool exromLine)
 void
 C64Memory::pokeZP(u8 addr, u8 value)
 {
-    CHECK_WATCHPOINT(addr)
+    CHECK_WRITE_WATCHPOINT(addr)
     
     if (likely(addr >= 0x02)) {
         ram[addr] = value;
@@ -513,7 +661,7 @@ C64Memory::pokeZP(u8 addr, u8 value)
 void
 C64Memory::pokeStack(u8 sp, u8 value)
 {
-    CHECK_WATCHPOINT(sp)
+    CHECK_WRITE_WATCHPOINT(0x100 + sp)
     
     ram[0x100 + sp] = value;
 }
@@ -521,7 +669,7 @@ C64Memory::pokeStack(u8 sp, u8 value)
 void
 C64Memory::pokeIO(u16 addr, u8 value)
 {
-    CHECK_WATCHPOINT(addr)
+    CHECK_WRITE_WATCHPOINT(addr)
     
     assert(addr >= 0xD000 && addr <= 0xDFFF);
     
@@ -559,7 +707,7 @@ C64Memory::pokeIO(u16 addr, u8 value)
         case 0xA: // Color RAM
         case 0xB: // Color RAM
             
-            colorRam[addr - 0xD800] = (value & 0x0F) | (rand() & 0xF0);
+            colorRam[addr - 0xD800] = (value & 0x0F) | (c64.random() & 0xF0);
             return;
             
         case 0xC: // CIA 1
@@ -41,13 +41,31 @@ public:
      */
     u8 colorRam[1024];
 
-    // Read Only Memory
-	/* Only specific memory cells are valid ROM locations. In total, the C64
-     * has three ROMs that are located at different addresses. Note, that the
-     * ROMs do not span over the whole 64KB range. Therefore, only some
-     * addresses are valid ROM addresses.
+    /* Read Only Memory
+     * The C64 has three ROMs which are mapped to $A000 (Basic), $D000
+     * (Character), and $E000 (Kernal). The ROM images are kept in the
+     * RomStore and shared with other emulator instances. They must never be
+     * written to.
      */
-    u8 rom[65536];
+    u8 *basicRom = NULL;
+    u8 *charRom = NULL;
+    u8 *kernalRom = NULL;
+    
+    /* FNV-64 hashes of the ROM images. Snapshots only store these values
+     * instead of the ROM contents.
+     */
+    u64 basicRomFNV = 0;
+    u64 charRomFNV = 0;
+    u64 kernalRomFNV = 0;
+    
+    /* FNV-64 hashes of the installed ROM images. Unlike the values above,
+     * these values are not serialized. After a snapshot has been restored,
+     * comparing both tells if an image needs to be exchanged. Hence, the
+     * RomStore is only consulted if the snapshot refers to a different ROM.
+     */
+    u64 installedBasicFNV = 0;
+    u64 installedCharFNV = 0;
+    u64 installedKernalFNV = 0;
         
     // Peek source lookup table
     MemoryType peekSrc[16];
@@ -55,6 +73,16 @@ public:
     // Poke target lookup table
     MemoryType pokeTarget[16];
     
+    /* Page table for the fast access path. For each memory page, these
+     * tables store a direct pointer to the page's contents if the page maps
+     * to plain RAM or ROM. For all other pages (I/O space, cartridge memory,
+     * processor port, unmapped memory) the entry is NULL and the access is
+     * handed over to the slow path. The tables are derived from peekSrc and
+     * pokeTarget in updatePageTable().
+     */
+    u8 *peekPage[256];
+    u8 *pokePage[256];
+    
     // Indicates if watchpoints should be checked
     bool checkWatchpoints = false;
     
@@ -66,6 +94,7 @@ public:
 public:
     
 	C64Memory(C64 &ref);
+    ~C64Memory();
     
 private:
     
@@ -115,7 +144,9 @@ private:
         
         & ram
         & colorRam
-        & rom
+        & basicRomFNV
+        & charRomFNV
+        & kernalRomFNV
         & peekSrc
         & pokeTarget;
     }
@@ -128,6 +159,7 @@ private:
     size_t _size() override { COMPUTE_SNAPSHOT_SIZE }
     size_t _load(u8 *buffer) override { LOAD_SNAPSHOT_ITEMS }
     size_t _save(u8 *buffer) override { SAVE_SNAPSHOT_ITEMS }
+    size_t didLoadFromBuffer(u8 *buffer) override;
     
     
     //
@@ -139,11 +171,28 @@ public:
     // Erases the RAM with the provided init pattern
     void eraseWithPattern(RamPattern pattern);
     
+    // Installs a Basic, Character, or Kernal Rom (NULL removes the Rom)
+    void installRom(RomType type, const u8 *data);
+    
+private:
+    
+    // Switches to the Rom image matching the hash restored from a snapshot
+    void restoreRom(u8 *&image, u64 &fnv, u64 &installed, size_t size);
+    
+public:
+    
+    
     /* Updates the peek and poke lookup tables. The lookup values depend on
      * three processor port bits and the cartridge exrom and game lines.
      */
     void updatePeekPokeLookupTables();
 
+    /* Updates the page table. This function needs to be called whenever the
+     * peek and poke lookup tables or the watchpoint state have changed. If
+     * watchpoints are enabled, all pages are redirected to the slow path.
+     */
+    void updatePageTable();
+
     // Returns the current peek source of the specified memory address
     MemoryType getPeekSource(u16 addr) { return peekSrc[addr >> 12]; }
     
@@ -153,7 +202,10 @@ public:
     // Reads a value from memory
     u8 peek(u16 addr, MemoryType source);
     u8 peek(u16 addr, bool gameLine, bool exromLine);
-    u8 peek(u16 addr) { return peek(addr, peekSrc[addr >> 12]); }
+    u8 peek(u16 addr) {
+        u8 *page = peekPage[addr >> 8];
+        return likely(page != NULL) ? page[addr & 0xFF] : peek(addr, peekSrc[addr >> 12]);
+    }
     u8 peekZP(u8 addr);
     u8 peekStack(u8 sp);
     u8 peekIO(u16 addr);
@@ -173,7 +225,11 @@ public:
     // Writing a value into memory
     void poke(u16 addr, u8 value, MemoryType target);
     void poke(u16 addr, u8 value, bool gameLine, bool exromLine);
-    void poke(u16 addr, u8 value) { poke(addr, value, pokeTarget[addr >> 12]); }
+    void poke(u16 addr, u8 value) {
+        u8 *page = pokePage[addr >> 8];
+        if (likely(page != NULL)) page[addr & 0xFF] = value;
+        else poke(addr, value, pokeTarget[addr >> 12]);
+    }
     void pokeZP(u8 addr, u8 value);
     void pokeStack(u8 sp, u8 value);
     void pokeIO(u16 addr, u8 value);
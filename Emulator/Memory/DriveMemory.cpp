@@ -12,7 +12,22 @@
 DriveMemory::DriveMemory(C64 &ref, Drive &dref) : C64Component(ref), drive(dref)
 {
     setDescription("1541MEM");    
-    memset(rom, 0, sizeof(rom));
+    rom = RomStore::acquire(NULL, 0x4000);
+    romFNV = installedRomFNV = RomStore::fnv(rom);
+}
+
+DriveMemory::~DriveMemory()
+{
+    RomStore::release(rom);
+}
+
+void
+DriveMemory::installRom(const u8 *data)
+{
+    u8 *newImage = RomStore::acquire(data, 0x4000);
+    RomStore::release(rom);
+    rom = newImage;
+    romFNV = installedRomFNV = RomStore::fnv(rom);
 }
 
 void 
@@ -26,6 +41,22 @@ DriveMemory::_reset()
     }
 }
 
+size_t
+DriveMemory::didLoadFromBuffer(u8 *buffer)
+{
+    // Only consult the RomStore if the snapshot refers to a different Rom
+    if (romFNV == installedRomFNV) return 0;
+    
+    // Switch to the Rom the snapshot was taken with
+    if (RomStore::exchange(rom, romFNV, 0x4000)) {
+        installedRomFNV = romFNV;
+    } else {
+        warn("Rom %016llx is not available. Keeping the current Rom.\n", romFNV);
+        romFNV = installedRomFNV;
+    }
+    return 0;
+}
+
 void 
 DriveMemory::_dump()
 {
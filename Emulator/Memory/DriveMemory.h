@@ -21,9 +21,20 @@ private:
     
 public:
     
-    // RAM (2 KB) and ROM (16 KB)
+    // RAM (2 KB)
     u8 ram[0x0800];
-    u8 rom[0x4000];
+    
+    /* ROM (16 KB)
+     * The ROM image is kept in the RomStore and shared with the other drive
+     * and other emulator instances. It must never be written to.
+     */
+    u8 *rom = NULL;
+    
+    // FNV-64 hash of the ROM image (stored in snapshots instead of the contents)
+    u64 romFNV = 0;
+    
+    // FNV-64 hash of the installed ROM image (not serialized, see C64Memory)
+    u64 installedRomFNV = 0;
     
     
     //
@@ -33,6 +44,10 @@ public:
 public:
     
     DriveMemory(C64 &ref, Drive &drive);
+    ~DriveMemory();
+    
+    // Installs a VC1541 Rom (NULL removes the Rom)
+    void installRom(const u8 *data);
     
 private:
     
@@ -60,7 +75,7 @@ private:
         worker
         
         & ram
-        & rom;
+        & romFNV;
     }
     
     template <class T>
@@ -71,6 +86,7 @@ private:
     size_t _size() override { COMPUTE_SNAPSHOT_SIZE }
     size_t _load(u8 *buffer) override { LOAD_SNAPSHOT_ITEMS }
     size_t _save(u8 *buffer) override { SAVE_SNAPSHOT_ITEMS }
+    size_t didLoadFromBuffer(u8 *buffer) override;
     
     
     //
@@ -79,6 +95,9 @@ private:
     
 public:
     
+    // Checks if an address is mapped to one of the VIAs
+    static bool isVIAAddr(u16 addr) { return !(addr & 0x8000) && (addr & 0x1FFF) >= 0x1800; }
+    
     // Reads a value from memory
     u8 peek(u16 addr);
     u8 peekZP(u8 addr) { return ram[addr]; }
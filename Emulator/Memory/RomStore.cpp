@@ -0,0 +1,133 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#include "C64.h"
+
+// A single image in the store
+struct RomStoreEntry { u8 *data; size_t size; u64 fnv; long references; };
+
+// All stored images (only a handful, hence a linear search is sufficient)
+static vector<RomStoreEntry> entries;
+
+// Protects the entries
+static std::mutex entryLock;
+
+u8 *
+RomStore::acquire(const u8 *data, size_t size)
+{
+    u8 *image = new u8[size];
+    
+    if (data) {
+        memcpy(image, data, size);
+    } else {
+        memset(image, 0, size);
+    }
+    u64 hash = fnv_1a_64(image, size);
+    
+    std::lock_guard<std::mutex> guard(entryLock);
+    
+    // Reuse an existing image if possible
+    for (auto &entry : entries) {
+        
+        if (entry.fnv == hash && entry.size == size && memcmp(entry.data, image, size) == 0) {
+            
+            delete [] image;
+            entry.references++;
+            return entry.data;
+        }
+    }
+    
+    entries.push_back(RomStoreEntry { image, size, hash, 1 });
+    return image;
+}
+
+u8 *
+RomStore::lookup(u64 fnv, size_t size)
+{
+    {   std::lock_guard<std::mutex> guard(entryLock);
+        
+        for (auto &entry : entries) {
+            
+            if (entry.fnv == fnv && entry.size == size) {
+                
+                entry.references++;
+                return entry.data;
+            }
+        }
+    }
+    
+    // An empty image can always be created
+    u8 *empty = acquire(NULL, size);
+    if (RomStore::fnv(empty) == fnv) return empty;
+    
+    release(empty);
+    return NULL;
+}
+
+void
+RomStore::release(u8 *image)
+{
+    if (image == NULL) return;
+    
+    std::lock_guard<std::mutex> guard(entryLock);
+    
+    for (auto it = entries.begin(); it != entries.end(); it++) {
+        
+        if (it->data == image) {
+            
+            if (--it->references == 0) {
+                delete [] it->data;
+                entries.erase(it);
+            }
+            return;
+        }
+    }
+    assert(false);
+}
+
+bool
+RomStore::exchange(u8 *&image, u64 fnv, size_t size)
+{
+    if (RomStore::fnv(image) == fnv) return true;
+    
+    u8 *newImage = lookup(fnv, size);
+    if (newImage == NULL) return false;
+    
+    release(image);
+    image = newImage;
+    return true;
+}
+
+u64
+RomStore::fnv(const u8 *image)
+{
+    std::lock_guard<std::mutex> guard(entryLock);
+    
+    for (auto &entry : entries) {
+        if (entry.data == image) return entry.fnv;
+    }
+    return 0;
+}
+
+long
+RomStore::count()
+{
+    std::lock_guard<std::mutex> guard(entryLock);
+    return (long)entries.size();
+}
+
+size_t
+RomStore::bytes()
+{
+    std::lock_guard<std::mutex> guard(entryLock);
+    
+    size_t result = 0;
+    for (auto &entry : entries) result += entry.size;
+    return result;
+}
@@ -0,0 +1,58 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+#ifndef _ROM_STORE_H
+#define _ROM_STORE_H
+
+#include "C64Object.h"
+
+/* Process-wide storage for ROM images. Emulator instances don't own private
+ * copies of their ROMs. They reference read-only images in the store. Each
+ * image is identified by its FNV-64 hash (the value returned by
+ * C64::romFNV64()) and is shared by all instances using the same ROM. The
+ * images are reference counted and freed when the last reference is dropped.
+ * All functions are thread-safe.
+ *
+ * The contents of an image must never be modified. To change a ROM, a new
+ * image is acquired and the old one is released.
+ */
+class RomStore {
+
+public:
+
+    /* Returns an image with the specified contents. If the store contains no
+     * such image yet, a new one is created. Passing NULL as data pointer
+     * returns an image filled with zeroes (no ROM installed).
+     */
+    static u8 *acquire(const u8 *data, size_t size);
+
+    /* Returns the image with the specified hash and size or NULL if the store
+     * doesn't contain such an image. Like acquire(), the function adds a
+     * reference to the returned image.
+     */
+    static u8 *lookup(u64 fnv, size_t size);
+
+    // Drops a reference to an image
+    static void release(u8 *image);
+
+    /* Replaces an image by the image with the specified hash. The function
+     * does nothing if the hash already matches. It returns false and keeps the
+     * old image if the store doesn't contain the requested image.
+     */
+    static bool exchange(u8 *&image, u64 fnv, size_t size);
+
+    // Returns the FNV-64 hash of an image
+    static u64 fnv(const u8 *image);
+
+    // Returns the number of stored images and the number of occupied bytes
+    static long count();
+    static size_t bytes();
+};
+
+#endif
@@ -20,7 +20,7 @@ ControlPort::ControlPort(int portNr, C64 &ref) : C64Component(ref)
     bulletCounter = 0;
     nextAutofireFrame = 0;
     
-    setDescription("ControlPort");    
+    setDescription(nr == 1 ? "ControlPort1" : "ControlPort2");
 }
 
 void
@@ -36,6 +36,9 @@ ControlPort::_reset()
 size_t
 ControlPort::didLoadFromBuffer(u8 *buffer)
 {
+    // Keep the joystick input when returning from a run-ahead
+    if (c64.isReturningFromRunAhead()) return 0;
+    
     // Discard active joystick movements
     button = false;
     axisX = 0;
@@ -58,6 +58,9 @@ ExpansionPort::_load(u8 *buffer)
         reader.ptr += cartridge->load(reader.ptr);
     }
     
+    // The loaded cartridge may differ in size
+    c64.invalidateLayout();
+    
     debug(SNP_DEBUG, "Recreated from %d bytes\n", reader.ptr - buffer);
     return reader.ptr - buffer;
 }
@@ -78,6 +81,13 @@ ExpansionPort::_save(u8 *buffer)
     return writer.ptr - buffer;
 }
 
+void
+ExpansionPort::invalidateLayout()
+{
+    HardwareComponent::invalidateLayout();
+    if (cartridge) cartridge->invalidateLayout();
+}
+
 void
 ExpansionPort::_dump()
 {
@@ -226,6 +236,7 @@ ExpansionPort::attachCartridge(Cartridge *c)
     detachCartridge();
     cartridge = c;
     crtType = c->getCartridgeType();
+    c64.invalidateLayout();
     
     // Reset cartridge to update exrom and game line on the expansion port
     cartridge->reset();
@@ -295,6 +306,7 @@ ExpansionPort::detachCartridge()
         delete cartridge;
         cartridge = NULL;
         crtType = CRT_NONE;
+        c64.invalidateLayout();
         
         setCartridgeMode(CRT_OFF);
         
@@ -93,6 +93,11 @@ private:
     size_t _size() override;
     size_t _load(u8 *buffer) override;
     size_t _save(u8 *buffer) override;
+    
+public:
+    
+    // The attached cartridge is serialized, too
+    void invalidateLayout() override;
 
  
     //
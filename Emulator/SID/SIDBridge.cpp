@@ -185,7 +185,8 @@ SIDBridge::getClockFrequency()
 size_t
 SIDBridge::didLoadFromBuffer(u8 *buffer)
 {
-    clearRingbuffer();
+    // Keep the samples of the presented frames when returning from a run-ahead
+    if (!c64.isReturningFromRunAhead()) clearRingbuffer();
     return 0;
 }
 
@@ -348,6 +349,8 @@ SIDBridge::poke(u16 addr, u8 value)
 void
 SIDBridge::executeUntil(u64 targetCycle)
 {
+    c64.profiler.enter(PROF_SID);
+    
     u64 missingCycles = targetCycle - cycles;
     
     if (missingCycles > PAL_CYCLES_PER_SECOND) {
@@ -357,6 +360,8 @@ SIDBridge::executeUntil(u64 targetCycle)
     
     execute(missingCycles);
     cycles = targetCycle;
+    
+    c64.profiler.leave();
 }
 
 void
@@ -466,6 +471,8 @@ SIDBridge::readStereoSamplesInterleaved(float *target, size_t n)
 void
 SIDBridge::writeData(short *data, size_t count)
 {
+    if (discardSamples) return;
+    
     // Check for buffer overflow
     if (bufferCapacity() < count) {
         handleBufferOverflow();
@@ -489,7 +496,7 @@ SIDBridge::handleBufferUnderflow()
     debug(SID_DEBUG, "RINGBUFFER UNDERFLOW (r: %ld w: %ld)\n", readPtr, writePtr);
 
     // Determine the elapsed seconds since the last pointer adjustment.
-    u64 now = mach_absolute_time();
+    u64 now = monotonicNanos();
     double elapsedTime = (double)(now - lastAlignment) / 1000000000.0;
     lastAlignment = now;
 
@@ -518,7 +525,7 @@ SIDBridge::handleBufferOverflow()
     debug(SID_DEBUG, "RINGBUFFER OVERFLOW (r: %ld w: %ld)\n", readPtr, writePtr);
     
     // Determine the elapsed seconds since the last pointer adjustment.
-    u64 now = mach_absolute_time();
+    u64 now = monotonicNanos();
     double elapsedTime = (double)(now - lastAlignment) / 1000000000.0;
     lastAlignment = now;
     
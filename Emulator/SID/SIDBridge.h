@@ -71,6 +71,13 @@ private:
     u32 readPtr;
     u32 writePtr;
     
+    /* Indicates if produced samples are thrown away instead of being written
+     * into the ringbuffer. The SIDs are clocked as usual. The flag is set
+     * while the emulator runs ahead to keep the audio of speculative frames
+     * away from the audio device.
+     */
+    bool discardSamples = false;
+    
     // Current volume (0 = silent)
     i32 volume;
     
@@ -234,6 +241,9 @@ public:
      */
     void writeData(short *data, size_t count);
     
+    // Enables or disables discarding of produced samples
+    void setDiscardSamples(bool value) { discardSamples = value; }
+    
     /* Handles a buffer underflow condition.
      * A buffer underflow occurs when the computer's audio device needs sound
      * samples than SID hasn't produced, yet.
@@ -247,7 +257,7 @@ public:
     void handleBufferOverflow();
     
     // Signals to ignore the next underflow or overflow condition.
-    void ignoreNextUnderOrOverflow() { lastAlignment = mach_absolute_time(); }
+    void ignoreNextUnderOrOverflow() { lastAlignment = monotonicNanos(); }
         
     // Moves read or write pointer forwards or backwards
     void advanceReadPtr() { readPtr = (readPtr + 1) % bufferSize; }
@@ -34,6 +34,9 @@ VICII::VICII(C64 &ref) : C64Component(ref)
     config.dmaChannel[G_ACCESS] = true;
     config.dmaChannel[P_ACCESS] = true;
     config.dmaChannel[S_ACCESS] = true;
+    config.indexedTexture = false;
+    config.frameSkip = 0;
+    config.headless = false;
 
     // Assign default DMA debugging colors
     setDmaDebugColor(R_ACCESS, RgbColor(1.0, 0.0, 0.0));
@@ -46,13 +49,11 @@ VICII::VICII(C64 &ref) : C64Component(ref)
     // Assign reference clock to all time delayed variables
     baLine.setClock(&cpu.cycle);
     gAccessResult.setClock(&cpu.cycle);
-    
-    // Create random background noise pattern
-    const size_t noiseSize = 2 * 512 * 512;
-    noise = new u32[noiseSize];
-    for (int i = 0; i < noiseSize; i++) {
-        noise[i] = rand() % 2 ? 0xFF000000 : 0xFFFFFFFF;
-    }
+}
+
+VICII::~VICII()
+{
+    deallocTextures();
 }
 
 void
@@ -94,16 +95,75 @@ VICII::_reset()
     upperComparisonVal = upperComparisonValue();
     lowerComparisonVal = lowerComparisonValue();
         
+    // Draw the first frame (unless running headless)
+    skipFrame = config.headless;
+    latchedRequests = requestedFrames;
+    skippedFrames = 0;
+    if (!skipFrame) allocBackBuffer();
+    
     // Reset the screen buffer pointers
-    emuTexture = emuTexturePtr = emuTexture1;
-    dmaTexture = dmaTexturePtr = dmaTexture1;
+    updateTexturePtrs(0);
+}
+
+void
+VICII::deallocTextures()
+{
+    for (int i = 0; i < 3; i++) {
+        
+        FrameBuffer &frame = frames.slot(i);
+        delete [] frame.emuTexture;
+        delete [] frame.dmaTexture;
+        delete [] frame.indexTexture;
+        frame = FrameBuffer();
+    }
+    delete [] noise;
+    noise = NULL;
+    
+    emuTexture = emuTexturePtr = NULL;
+    dmaTexture = dmaTexturePtr = NULL;
+    indexTexture = indexTexturePtr = NULL;
+}
+
+void
+VICII::allocBackBuffer()
+{
+    FrameBuffer &frame = frames.back();
+    
+    if (!frame.emuTexture) {
+        
+        frame.emuTexture = new int[TEX_HEIGHT * TEX_WIDTH];
+        frame.dmaTexture = new int[TEX_HEIGHT * TEX_WIDTH];
+        frame.indexTexture = new u8[TEX_HEIGHT * TEX_WIDTH]();
+        resetEmuTexture(frame.emuTexture);
+        resetDmaTexture(frame.dmaTexture);
+    }
+    
+    emuTexture = frame.emuTexture;
+    dmaTexture = frame.dmaTexture;
+    indexTexture = frame.indexTexture;
 }
 
 void
-VICII::resetEmuTexture(int nr)
+VICII::freeBackBuffer()
 {
-    assert(nr == 1 || nr == 2);
-    int *p = nr == 1 ? emuTexture1 : emuTexture2;
+    FrameBuffer &frame = frames.back();
+    
+    delete [] frame.emuTexture;
+    delete [] frame.dmaTexture;
+    delete [] frame.indexTexture;
+    frame.emuTexture = NULL;
+    frame.dmaTexture = NULL;
+    frame.indexTexture = NULL;
+    
+    emuTexture = emuTexturePtr = NULL;
+    dmaTexture = dmaTexturePtr = NULL;
+    indexTexture = indexTexturePtr = NULL;
+}
+
+void
+VICII::resetEmuTexture(int *p)
+{
+    if (!p) return;
 
     // Determine the HBLANK / VBLANK area
     long width = isPAL() ? PAL_PIXELS : NTSC_PIXELS;
@@ -129,16 +189,27 @@ VICII::resetEmuTexture(int nr)
 }
 
 void
-VICII::resetDmaTexture(int nr)
+VICII::resetDmaTexture(int *p)
 {
-    assert(nr == 1 || nr == 2);
-    int *p = nr == 1 ? dmaTexture1 : dmaTexture2;
+    if (!p) return;
 
     for (int i = 0; i < TEX_HEIGHT * TEX_WIDTH; i++) {
         p[i] = 0xFF000000;
     }
 }
 
+void
+VICII::resetEmuTextures()
+{
+    for (int i = 0; i < 3; i++) resetEmuTexture(frames.slot(i).emuTexture);
+}
+
+void
+VICII::resetDmaTextures()
+{
+    for (int i = 0; i < 3; i++) resetDmaTexture(frames.slot(i).dmaTexture);
+}
+
 long
 VICII::getConfigItem(ConfigOption option)
 {
@@ -168,6 +239,9 @@ VICII::getConfigItem(ConfigOption option)
         case OPT_CUT_OPACITY:      return config.cutOpacity;
         case OPT_SS_COLLISIONS:    return config.checkSSCollisions;
         case OPT_SB_COLLISIONS:    return config.checkSBCollisions;
+        case OPT_INDEXED_TEXTURE:  return config.indexedTexture;
+        case OPT_FRAME_SKIP:       return config.frameSkip;
+        case OPT_VIC_HEADLESS:     return config.headless;
 
         default: assert(false);
     }
@@ -225,10 +299,15 @@ VICII::setConfigItem(ConfigOption option, long value)
             if (config.dmaDebug == value) {
                 return false;
             }
+            if (value && config.headless) {
+                warn("DMA debugging is not available in headless mode\n");
+                return false;
+            }
             suspend();
             config.dmaDebug = value;
             resetDmaTextures();
             c64.updateVicFunctionTable();
+            updateTextureFormat();
             resume();
             return true;
             
@@ -305,7 +384,10 @@ VICII::setConfigItem(ConfigOption option, long value)
 
         case OPT_CUT_LAYERS:
             
+            suspend();
             config.cutLayers = value;
+            updateTextureFormat();
+            resume();
             return true;
             
         case OPT_CUT_OPACITY:
@@ -323,6 +405,53 @@ VICII::setConfigItem(ConfigOption option, long value)
             config.checkSBCollisions = value;
             return true;
 
+        case OPT_INDEXED_TEXTURE:
+            
+            if (config.indexedTexture == value) {
+                return false;
+            }
+            
+            suspend();
+            config.indexedTexture = value;
+            updateTextureFormat();
+            resume();
+            return true;
+
+        case OPT_FRAME_SKIP:
+            
+            if (value < 0 || value > 0xFF) {
+                warn("Invalid frame skip value: %ld\n", value);
+                return false;
+            }
+            if (config.frameSkip == value) {
+                return false;
+            }
+            
+            config.frameSkip = (u8)value;
+            return true;
+
+        case OPT_VIC_HEADLESS:
+            
+            if (config.headless == value) {
+                return false;
+            }
+            if (value && config.dmaDebug) {
+                warn("Headless mode is not available while DMA debugging\n");
+                return false;
+            }
+            
+            suspend();
+            config.headless = value;
+            if (value) {
+                
+                // Stop drawing immediately, because the back buffer is gone
+                skipFrame = true;
+                freeBackBuffer();
+                updateTexturePtrs(0);
+            }
+            resume();
+            return true;
+
         case OPT_GLUE_LOGIC:
             
             if (!isGlueLogic(value)) {
@@ -637,22 +766,87 @@ VICII::isVBlankLine(unsigned rasterline)
     }
 }
 
+bool
+VICII::updateStableFrame()
+{
+    if (!frames.update()) return false;
+    
+    // The new stable frame hasn't been converted to RGBA yet
+    stableTextureConverted = false;
+    return true;
+}
+
 void *
-VICII::stableEmuTexture()
+VICII::stableEmuTexture(bool advance)
 {
-    return emuTexture == emuTexture1 ? emuTexture2 : emuTexture1;
+    if (advance) updateStableFrame();
+    FrameBuffer &frame = frames.front();
+    
+    // Convert the color indices if this hasn't happened yet
+    if (renderIndices && !stableTextureConverted && frame.emuTexture) {
+        
+        convertIndexTexture(frame.indexTexture, (u32 *)frame.emuTexture);
+        stableTextureConverted = true;
+    }
+    
+    return frame.emuTexture;
+}
+
+u8 *
+VICII::stableIndexTexture()
+{
+    return frames.front().indexTexture;
 }
 
 void *
 VICII::stableDmaTexture()
 {
-    return dmaTexture == dmaTexture1 ? dmaTexture2 : dmaTexture1;
+    return frames.front().dmaTexture;
+}
+
+bool
+VICII::copyLatestFrame(u32 *dst, long pitch,
+                       long x, long y, long width, long height)
+{
+    const FrameBuffer &frame = frames.latest();
+    if (!frame.emuTexture) return false;
+    
+    assert(x >= 0 && x + width <= TEX_WIDTH);
+    assert(y >= 0 && y + height <= TEX_HEIGHT);
+    
+    for (long i = 0; i < height; i++, dst += pitch) {
+        
+        long offset = (y + i) * TEX_WIDTH + x;
+        
+        if (renderIndices) {
+            
+            // Don't touch the emulator texture (the GUI might convert it)
+            const u8 *src = frame.indexTexture + offset;
+            for (long j = 0; j < width; j++) dst[j] = rgbaTable[src[j] & 0xF];
+            
+        } else {
+            
+            memcpy(dst, frame.emuTexture + offset, width * 4);
+        }
+    }
+    return true;
 }
 
 u32 *
 VICII::getNoise()
 {
-    int offset = rand() % (512 * 512);
+    // Create a random background noise pattern when it is needed first
+    if (!noise) {
+        
+        const size_t noiseSize = 2 * 512 * 512;
+        u32 seed = 1;
+        noise = new u32[noiseSize];
+        for (size_t i = 0; i < noiseSize; i++) {
+            noise[i] = xorshift32(seed) % 2 ? 0xFF000000 : 0xFFFFFFFF;
+        }
+    }
+    
+    int offset = xorshift32(noiseState) % (512 * 512);
     return noise + offset;
 }
 
@@ -1012,29 +1206,107 @@ VICII::beginFrame()
 void
 VICII::endFrame()
 {
-    // Run the DMA debugger (if enabled)
-    if (config.dmaDebug) {
-        computeOverlay();
+    // Count the frame (the counter provides the frame numbers)
+    finishedFrames++;
+    
+    // Publish the frame unless nothing has been drawn
+    if (!skipFrame) {
+        
+        // Run the DMA debugger (if enabled)
+        if (config.dmaDebug) {
+            computeOverlay();
+        }
+        
+        // Hand the finished frame over to the GUI
+        frames.back().nr = finishedFrames;
+        frames.publish();
+        
+        // Continue drawing into the new back buffer
+        emuTexture = frames.back().emuTexture;
+        dmaTexture = frames.back().dmaTexture;
+        indexTexture = frames.back().indexTexture;
+        if (config.dmaDebug) { resetEmuTexture(emuTexture); resetDmaTexture(dmaTexture); }
+        
+        // All requests made before this frame has started have been served
+        servedRequests = latchedRequests;
     }
+    
+    // Decide whether the next frame is drawn
+    updateFrameSkip();
+    
+    // Start drawing at the top of the working textures
+    updateTexturePtrs(0);
+}
 
-    // Switch texture buffers
-    if (emuTexture == emuTexture1) {
+void
+VICII::updateFrameSkip()
+{
+    // Latch the requests this frame is going to serve
+    latchedRequests = requestedFrames;
+    
+    if (latchedRequests != servedRequests) {
+        
+        // Draw the requested frame (in headless mode, a back buffer is needed now)
+        allocBackBuffer();
+        skipFrame = false;
+        skippedFrames = 0;
+        return;
+    }
+    
+    if (config.headless) {
+        
+        skipFrame = true;
+        freeBackBuffer();
+        return;
+    }
+    
+    /* The DMA debugger accumulates its overlay in the working texture. To
+     * keep it consistent, frames are never skipped while it is running.
+     */
+    if (skippedFrames < config.frameSkip && !config.dmaDebug) {
         
-        assert(dmaTexture == dmaTexture1);
-        emuTexture = emuTexturePtr = emuTexture2;
-        dmaTexture = dmaTexturePtr = dmaTexture2;
-        if (config.dmaDebug) { resetEmuTexture(2); resetDmaTexture(2); }
+        skipFrame = true;
+        skippedFrames++;
+        
+    } else {
+        
+        skipFrame = false;
+        skippedFrames = 0;
+    }
+    
+    // Frames are drawn into buffers that are allocated on demand
+    if (!skipFrame) allocBackBuffer();
+}
 
+void
+VICII::updateTexturePtrs(u16 line)
+{
+    if (skipFrame) {
+        
+        // Skipped frames are drawn into scratch lines that are never shown
+        emuTexturePtr = skippedEmuLine;
+        indexTexturePtr = skippedIndexLine;
+        
     } else {
         
-        assert(emuTexture == emuTexture2);
-        assert(dmaTexture == dmaTexture2);
-        emuTexture = emuTexturePtr = emuTexture1;
-        dmaTexture = dmaTexturePtr = dmaTexture1;
-        if (config.dmaDebug) { resetEmuTexture(1); resetDmaTexture(1); }
+        emuTexturePtr = emuTexture + (line * TEX_WIDTH);
+        dmaTexturePtr = dmaTexture + (line * TEX_WIDTH);
+        indexTexturePtr = indexTexture + (line * TEX_WIDTH);
     }
 }
 
+void
+VICII::updateTextureFormat()
+{
+    /* The DMA debugger and the layer cutter operate on RGBA values. If one
+     * of them is active, VICII falls back to writing RGBA values.
+     */
+    renderIndices =
+    config.indexedTexture && !config.dmaDebug && !(config.cutLayers & 0xF00);
+    
+    stableTextureConverted = false;
+}
+
 void
 VICII::processDelayedActions()
 {
@@ -1107,12 +1379,11 @@ VICII::endRasterline()
     }
     
     // Cut out layers if requested
-    if (config.cutLayers) cutLayers();
+    if (config.cutLayers && !renderIndices && !skipFrame) cutLayers();
 
     // Prepare buffers ready for the next line
     for (unsigned i = 0; i < TEX_WIDTH; i++) { zBuffer[i] = pixelSource[i] = 0; }
         
     // Advance texture pointers
-    emuTexturePtr = emuTexture + (c64.rasterLine * TEX_WIDTH);
-    dmaTexturePtr = dmaTexture + (c64.rasterLine * TEX_WIDTH);
+    updateTexturePtrs(c64.rasterLine);
 }
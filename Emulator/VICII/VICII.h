@@ -12,6 +12,8 @@
 
 #include "C64Component.h"
 #include "TimeDelayed.h"
+#include "TripleBuffer.h"
+#include <atomic>
 
 class VICII : public C64Component {
 
@@ -477,42 +479,111 @@ private:
     // C64 colors in RGBA format (updated in updatePalette())
     u32 rgbaTable[16];
     
-    // Buffer storing background noise (random black and white pixels)
-    u32 *noise;
+    // Buffer storing background noise (created by getNoise() when needed)
+    u32 *noise = NULL;
+    
+    /* State of the random number generator used by getNoise(). The function
+     * is called by the GUI. Hence, it must not touch the emulator's generator.
+     */
+    u32 noiseState = 1;
 
-    /* Texture buffers. VICII outputs the generated texture into these buffers.
-     * At any time, one buffer is the working buffer and the other one is the
-     * stable buffer. While VICII always writes into the working buffer, the
-     * GUI accesses the stable buffer at a constant frame rate and copies it
-     * into the texture RAM of the graphics card.
+    /* Texture buffers of a single frame.
      *
-     * The emuTexture buffers contain the emulator texture. It is the texture
-     * that is usually drawn by the GUI. The dmaTexture buffers contain the
+     * The emuTexture buffer contains the emulator texture. It is the texture
+     * that is usually drawn by the GUI. The dmaTexture buffer contains the
      * texture generated by the DMA debugger. If DMA debugging is enabled, this
      * texture is superimposed on the emulator texture.
+     *
+     * If the indexed texture format is selected, VICII writes color indices
+     * (0 ... 15) into the indexTexture buffer instead of writing RGBA values
+     * into the emuTexture buffer. The stable frame is converted to RGBA values
+     * when the GUI requests the stable emulator texture for the first time.
      */
-    int *emuTexture1 = new int[TEX_HEIGHT * TEX_WIDTH];
-    int *emuTexture2 = new int[TEX_HEIGHT * TEX_WIDTH];
-    int *dmaTexture1 = new int[TEX_HEIGHT * TEX_WIDTH];
-    int *dmaTexture2 = new int[TEX_HEIGHT * TEX_WIDTH];
-    /*
+    struct FrameBuffer {
+        
+        int *emuTexture = NULL;
+        int *dmaTexture = NULL;
+        u8 *indexTexture = NULL;
+        
+        // Frame number (0 = nothing has been drawn into this buffer yet)
+        u64 nr = 0;
+    };
+    
+    /* Frame buffers. VICII draws into the back buffer of this triple buffer.
+     * When a frame has been finished, the back buffer is published. The GUI
+     * picks up the most recently published frame at its own frame rate,
+     * copies it into the texture RAM of the graphics card, and keeps it as
+     * the stable frame until it picks up the next one. Neither side ever
+     * waits for the other one. If VICII finishes frames faster than the GUI
+     * picks them up (e.g., in warp mode), frames are dropped.
+     *
+     * The textures of a slot are allocated by the emulator thread when the
+     * slot is used as back buffer for a frame that is drawn. Hence, a slot
+     * lacks its textures until a frame has been drawn into it. Since only
+     * drawn frames are published, the GUI never sees a slot losing its
+     * textures. In headless mode, the textures of the back buffer are freed,
+     * so that at most the published slots hold textures.
      */
-     
-    /* Pointer to the current working texture. This variable points either to
-     * the first or the second texture buffer. After a frame has been finished,
-     * the pointer is redirected to the other buffer.
+    TripleBuffer<FrameBuffer> frames;
+    
+    /* Number of frames finished so far. The counter is never reset. It
+     * provides the frame numbers, which are strictly increasing. Hence, the
+     * GUI can detect dropped or skipped frames by comparing frame numbers.
      */
-    int *emuTexture;
-    int *dmaTexture;
+    u64 finishedFrames = 0;
+    
+    // Pointers to the textures of the back buffer (the working textures)
+    int *emuTexture = NULL;
+    int *dmaTexture = NULL;
+    u8 *indexTexture = NULL;
 
     /* Pointer to the beginning of the current rasterline inside the current
      * working textures. These pointers are used by all rendering methods to
-     * write pixels. It always points to the beginning of a rasterline, either
-     * the first or the second texture buffer. They are reset at the beginning
-     * of each frame and incremented at the beginning of each rasterline.
+     * write pixels. It always points to the beginning of a rasterline inside
+     * the back buffer. They are reset at the beginning of each frame and
+     * incremented at the beginning of each rasterline.
      */
     int *emuTexturePtr;
     int *dmaTexturePtr;
+    u8 *indexTexturePtr;
+    
+    /* Scratch lines receiving the pixels of skipped frames. While a frame is
+     * skipped, the texture pointers refer to these lines instead of the back
+     * buffer. Hence, the drawing routines never need to check skipFrame.
+     */
+    int skippedEmuLine[TEX_WIDTH];
+    u8 skippedIndexLine[TEX_WIDTH];
+    
+    /* Indicates if color indices are written instead of RGBA values. The
+     * variable reflects config.indexedTexture unless a debug feature requires
+     * RGBA values (see updateTextureFormat()).
+     */
+    bool renderIndices = false;
+    
+    // Indicates if the stable frame has been converted to RGBA (GUI side)
+    bool stableTextureConverted = false;
+    
+    /* Indicates if the current frame is skipped. In a skipped frame, VICII
+     * runs all of its logic, but doesn't write into the texture buffers. The
+     * depth buffer and the pixel sources are still maintained, because the
+     * collision checks rely on them. The stable texture keeps the last frame
+     * that has been drawn. In headless mode, all frames are skipped unless a
+     * frame has been requested.
+     */
+    bool skipFrame = false;
+    
+    // Number of frames skipped since the last drawn frame
+    u8 skippedFrames = 0;
+    
+    /* Frame request sequence numbers. requestFrame() increments the first
+     * counter. At the beginning of each frame, its value is latched in the
+     * second variable. When a drawn frame is published, the latched value is
+     * copied to the third counter. Hence, a request is only considered served
+     * by a frame that has been started after the request was made.
+     */
+    std::atomic<u64> requestedFrames { 0 };
+    u64 latchedRequests = 0;
+    std::atomic<u64> servedRequests { 0 };
 
     /* VICII utilizes a depth buffer to determine pixel priority. The render
      * routines only write a color value, if it is closer to the view point.
@@ -573,16 +644,33 @@ private:
 public:
 	
     VICII(C64 &ref);
+    ~VICII();
     
 private:
     
     void _initialize() override;
     void _reset() override;
 
-    void resetEmuTexture(int nr);
-    void resetEmuTextures() { resetEmuTexture(1); resetEmuTexture(2); }
-    void resetDmaTexture(int nr);
-    void resetDmaTextures() { resetDmaTexture(1); resetDmaTexture(2); }
+    // Frees the texture buffers and the noise buffer
+    void deallocTextures();
+    
+    // Allocates or frees the textures of the back buffer
+    void allocBackBuffer();
+    void freeBackBuffer();
+
+    void resetEmuTexture(int *texture);
+    void resetEmuTextures();
+    void resetDmaTexture(int *texture);
+    void resetDmaTextures();
+    
+    // Decides whether color indices or RGBA values are written
+    void updateTextureFormat();
+    
+    // Decides whether the next frame is drawn or skipped
+    void updateFrameSkip();
+    
+    // Points the texture pointers to the specified line of the back buffer
+    void updateTexturePtrs(u16 line);
 
     
     //
@@ -785,10 +873,61 @@ public:
     // Accessing the screen buffer and display properties
     //
     
-    // Returns the currently stable textures
-    void *stableEmuTexture();
+    /* Picks up the most recently finished frame as the new stable frame.
+     * Returns false if no frame has been finished since the last call. In
+     * this case, the stable frame stays the same. The stable frame is owned
+     * by the GUI. Hence, all functions accessing the stable frame must be
+     * called from the same (GUI) thread. The GUI is expected to call this
+     * function once per screen refresh, before it reads any stable texture,
+     * unless it lets stableEmuTexture() advance the frame.
+     */
+    bool updateStableFrame();
+    
+    // Returns the number of the stable frame (0 = no frame finished yet)
+    u64 stableFrameNr() { return frames.front().nr; }
+    
+    /* Returns the textures of the stable frame. If advance is true,
+     * stableEmuTexture() calls updateStableFrame() first. This keeps GUIs
+     * working that read the emulator texture before any other stable texture
+     * without calling updateStableFrame() themselves. GUIs that call
+     * updateStableFrame() explicitly pass false. stableDmaTexture() never
+     * switches to a newer frame. If the indexed texture format is selected,
+     * the index texture is converted to RGBA values before the emulator
+     * texture is returned for the first time. NULL is returned if no frame
+     * has been picked up yet. In headless mode, the textures keep the last
+     * frame that has been requested.
+     */
+    void *stableEmuTexture(bool advance = true);
     void *stableDmaTexture();
     
+    /* Returns the index texture of the stable frame. The texture is only
+     * updated if the indexed texture format is selected. Each byte holds the
+     * C64 color of one pixel.
+     */
+    u8 *stableIndexTexture();
+    
+    /* Copies a section of the most recently finished frame in RGBA format.
+     * VICII doesn't modify this frame before it has finished the next one.
+     * Hence, unlike the stable textures, the function can be called by the
+     * emulator thread (e.g., when a snapshot is taken). In headless mode, the
+     * frame drawn for the last request is copied. Returns false if no frame
+     * has been finished yet.
+     */
+    bool copyLatestFrame(u32 *dst, long pitch,
+                         long x, long y, long width, long height);
+    
+    // Indicates if VICII currently writes color indices
+    bool rendersIndices() { return renderIndices; }
+    
+    /* Requests a single frame. The next frame that is drawn completely is
+     * published for the GUI. In headless mode, the back buffer is allocated
+     * at the beginning of this frame and released again afterwards. The
+     * function can be called from any thread. isFrameRequested() returns
+     * false once the requested frame is available.
+     */
+    void requestFrame() { requestedFrames++; }
+    bool isFrameRequested() { return servedRequests < requestedFrames; }
+    
     // Returns a pointer to randon noise
     u32 *getNoise();
     
@@ -796,6 +935,9 @@ public:
     u32 getColor(unsigned nr);
     u32 getColor(unsigned nr, Palette palette);
     
+    // Translates a texture of color indices into RGBA values
+    void convertIndexTexture(const u8 *src, u32 *dst);
+    
     // Gets or sets a monitor parameter
     double getBrightness() { return brightness; }
     void setBrightness(double value);
@@ -1253,17 +1395,23 @@ private:
     // Internal drawing routines (called by draw(), draw17(), and drae55())
     //
     
+    /* All internal drawing routines are templated by the texture format. If
+     * parameter indices is true, color indices are written into the index
+     * texture. Otherwise, RGBA values are written into the emulator texture.
+     * The public entry points select the instance once per cycle.
+     */
+    
     // Draws 8 border pixels. Invoked inside draw().
-    void drawBorder();
+    template <bool indices> void drawBorder();
     
     // Draws the border pixels in cycle 17 (see draw17())
-    void drawBorder17();
+    template <bool indices> void drawBorder17();
     
     // Draws the border pixels in cycle 55 (see draw55())
-    void drawBorder55();
+    template <bool indices> void drawBorder55();
     
     // Draws 8 canvas pixels (see draw())
-    void drawCanvas();
+    template <bool indices> void drawCanvas();
     
     /* Draws a single canvas pixel
      *
@@ -1273,14 +1421,29 @@ private:
      *  loadShiftReg : forces the shift register to be reloaded
      *  updateColors : forces the four selectable colors to be reloaded
      */
+    template <bool indices>
     void drawCanvasPixel(u8 pixel,
                          u8 mode,
                          u8 d016,
                          bool loadShiftReg,
                          bool updateColors);
     
+    /* Draws 8 canvas pixels at once (see drawCanvas()). The shift register
+     * is loaded in the first pixel and all pixels are drawn with the same
+     * mode and the same colors. The sequencer ends up in the same state as
+     * after eight calls to drawCanvasPixel().
+     */
+    template <bool indices> void drawCanvasFast(u8 mode);
+    
+    /* Writes 8 canvas pixels into the pixel buffers. The pixels are
+     * synthesized from the specified shift register contents with the
+     * colors stored in col[].
+     */
+    template <bool indices> void drawCanvasChunk(u8 data, bool multicolor);
+    
     // Draws 8 sprite pixels (see draw())
     void drawSprites();
+    template <bool indices> void _drawSprites();
     
     /* Draws a single sprite pixel for all sprites
      *
@@ -1288,6 +1451,7 @@ private:
      *    enableBits : the spriteDisplay bits
      *    freezeBits : forces the sprites shift register to freeze temporarily
      */
+    template <bool indices>
     void drawSpritePixel(unsigned pixel,
                          u8 enableBits,
                          u8 freezeBits);
@@ -1308,7 +1472,8 @@ private:
     // Writes a single color value into the screenbuffer
     #define COLORIZE(index,color) \
         assert(index < TEX_WIDTH); \
-        emuTexturePtr[index] = rgbaTable[color];
+        if (indices) indexTexturePtr[index] = color; \
+        else emuTexturePtr[index] = rgbaTable[color];
     
     /* Sets a single frame pixel. The upper bit in pixelSource is cleared to
      * prevent sprite/foreground collision detection in border area.
@@ -1334,7 +1499,7 @@ private:
         pixelSource[index] = 0x00; }
     
     // Draw a single sprite pixel
-    void setSpritePixel(unsigned sprite, unsigned pixel, u8 color);
+    template <bool indices> void setSpritePixel(unsigned sprite, unsigned pixel, u8 color);
         
     
 	//
@@ -156,6 +156,15 @@ typedef struct
     u16 cutLayers;
     u8 cutOpacity;
     
+    // Texture format (color indices instead of RGBA values)
+    bool indexedTexture;
+    
+    // Number of frames that are not drawn after each drawn frame
+    u8 frameSkip;
+    
+    // Headless mode (no texture buffers, frames are only drawn on request)
+    bool headless;
+    
     // Cheating
     bool checkSSCollisions;
     bool checkSBCollisions;
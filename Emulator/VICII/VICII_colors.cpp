@@ -13,6 +13,12 @@
 
 #include "C64.h"
 
+#if VICII_SIMD && defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif VICII_SIMD && defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 double gammaCorrect(double value, double source, double target)
 {
     // Reverse gamma correction of source
@@ -442,6 +448,93 @@ VICII::updatePalette()
     for (unsigned i = 0; i < 16; i++) {
         rgbaTable[i] = getColor(i, config.palette);
     }
+    
+    // Make sure the stable index texture is converted with the new colors
+    stableTextureConverted = false;
 }
 
-
+void
+VICII::convertIndexTexture(const u8 *src, u32 *dst)
+{
+    // Only convert the area that is drawn by VICII
+    long first = FIRST_VISIBLE_PIXEL;
+    long last = FIRST_VISIBLE_PIXEL + VISIBLE_PIXELS;
+    long height = getRasterlinesPerFrame();
+    
+#if VICII_SIMD && defined(__SSSE3__)
+    
+    // Split the RGBA values into four byte tables (one per color channel)
+    u8 channel[4][16];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) channel[c][i] = (u8)(rgbaTable[i] >> (8 * c));
+    }
+    __m128i t0 = _mm_loadu_si128((const __m128i *)channel[0]);
+    __m128i t1 = _mm_loadu_si128((const __m128i *)channel[1]);
+    __m128i t2 = _mm_loadu_si128((const __m128i *)channel[2]);
+    __m128i t3 = _mm_loadu_si128((const __m128i *)channel[3]);
+    
+#elif VICII_SIMD && defined(__ARM_NEON) && defined(__aarch64__)
+    
+    // Split the RGBA values into four byte tables (one per color channel)
+    u8 channel[4][16];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) channel[c][i] = (u8)(rgbaTable[i] >> (8 * c));
+    }
+    uint8x16_t t0 = vld1q_u8(channel[0]);
+    uint8x16_t t1 = vld1q_u8(channel[1]);
+    uint8x16_t t2 = vld1q_u8(channel[2]);
+    uint8x16_t t3 = vld1q_u8(channel[3]);
+    
+#endif
+    
+    for (long y = 0; y < height; y++) {
+        
+        /* Lines inside the vertical blanking area are never drawn. Note that
+         * texture row y holds rasterline y + 1 (see endRasterline()).
+         */
+        if (isVBlankLine((unsigned)y + 1)) continue;
+        
+        const u8 *s = src + y * TEX_WIDTH;
+        u32 *d = dst + y * TEX_WIDTH;
+        long x = first;
+        
+#if VICII_SIMD && defined(__SSSE3__)
+        
+        // Translate 16 pixels at once
+        for (; x + 16 <= last; x += 16) {
+            
+            __m128i index = _mm_loadu_si128((const __m128i *)(s + x));
+            __m128i r = _mm_shuffle_epi8(t0, index);
+            __m128i g = _mm_shuffle_epi8(t1, index);
+            __m128i b = _mm_shuffle_epi8(t2, index);
+            __m128i a = _mm_shuffle_epi8(t3, index);
+            
+            __m128i rg0 = _mm_unpacklo_epi8(r, g), rg1 = _mm_unpackhi_epi8(r, g);
+            __m128i ba0 = _mm_unpacklo_epi8(b, a), ba1 = _mm_unpackhi_epi8(b, a);
+            
+            _mm_storeu_si128((__m128i *)(d + x), _mm_unpacklo_epi16(rg0, ba0));
+            _mm_storeu_si128((__m128i *)(d + x + 4), _mm_unpackhi_epi16(rg0, ba0));
+            _mm_storeu_si128((__m128i *)(d + x + 8), _mm_unpacklo_epi16(rg1, ba1));
+            _mm_storeu_si128((__m128i *)(d + x + 12), _mm_unpackhi_epi16(rg1, ba1));
+        }
+        
+#elif VICII_SIMD && defined(__ARM_NEON) && defined(__aarch64__)
+        
+        // Translate 16 pixels at once (vst4 interleaves the channels)
+        for (; x + 16 <= last; x += 16) {
+            
+            uint8x16_t index = vld1q_u8(s + x);
+            uint8x16x4_t rgba;
+            rgba.val[0] = vqtbl1q_u8(t0, index);
+            rgba.val[1] = vqtbl1q_u8(t1, index);
+            rgba.val[2] = vqtbl1q_u8(t2, index);
+            rgba.val[3] = vqtbl1q_u8(t3, index);
+            vst4q_u8((u8 *)(d + x), rgba);
+        }
+        
+#endif
+        
+        // Translate the remaining pixels one by one
+        for (; x < last; x++) d[x] = rgbaTable[s[x] & 0xF];
+    }
+}
@@ -9,28 +9,49 @@
 
 #include "C64.h"
 
+#if VICII_SIMD && defined(__SSE2__)
+#include <emmintrin.h>
+#elif VICII_SIMD && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 void
 VICII::draw()
 {
-    drawCanvas();
-    drawBorder();
+    if (renderIndices) {
+        drawCanvas<true>();
+        drawBorder<true>();
+    } else {
+        drawCanvas<false>();
+        drawBorder<false>();
+    }
 }
 
 void
 VICII::draw17()
 {
-    drawCanvas();
-    drawBorder17();
+    if (renderIndices) {
+        drawCanvas<true>();
+        drawBorder17<true>();
+    } else {
+        drawCanvas<false>();
+        drawBorder17<false>();
+    }
 }
 
 void
 VICII::draw55()
 {
-    drawCanvas();
-    drawBorder55();
+    if (renderIndices) {
+        drawCanvas<true>();
+        drawBorder55<true>();
+    } else {
+        drawCanvas<false>();
+        drawBorder55<false>();
+    }
 }
 
-void
+template <bool indices> void
 VICII::drawBorder()
 {
     if (flipflops.delayed.main) {
@@ -43,7 +64,7 @@ VICII::drawBorder()
     }
 }
 
-void
+template <bool indices> void
 VICII::drawBorder17()
 {
     if (flipflops.delayed.main && !flipflops.current.main) {
@@ -57,11 +78,11 @@ VICII::drawBorder17()
     } else {
 
         // 40 column mode (all eight pixels are drawn)
-        drawBorder();
+        drawBorder<indices>();
     }
 }
 
-void
+template <bool indices> void
 VICII::drawBorder55()
 {
     if (!flipflops.delayed.main && flipflops.current.main) {
@@ -71,11 +92,11 @@ VICII::drawBorder55()
   
     } else {
         
-        drawBorder();
+        drawBorder<indices>();
     }
 }
 
-void
+template <bool indices> void
 VICII::drawCanvas()
 {
     u8 d011, d016, newD016, mode, oldMode, xscroll;
@@ -91,10 +112,14 @@ VICII::drawCanvas()
          *  current background color is displayed (this area is normally covered
          *  by the border)." [C.B.]
          */
+#if VICII_SIMD
+        drawCanvasChunk<indices>(0, false);
+#else
         SET_BACKGROUND_PIXEL(0, col[0]);
         for (unsigned pixel = 1; pixel < 8; pixel++) {
             SET_BACKGROUND_PIXEL(pixel, col[0]);
         }
+#endif
         return;
     }
     
@@ -109,7 +134,21 @@ VICII::drawCanvas()
     xscroll = d016 & 0x07;
     mode = (d011 & 0x60) | (d016 & 0x10); // -xxx ----
 
-    drawCanvasPixel(0, mode, d016, xscroll == 0, true);
+#if VICII_SIMD
+    /* If the shift register is loaded in the first pixel and no register
+     * change takes effect in this cycle, all pixels are drawn the same way.
+     */
+    if (xscroll == 0 && sr.canLoad &&
+        d011 == reg.current.ctrl1 && d016 == reg.current.ctrl2 &&
+        memcmp(reg.delayed.colors + COLREG_BG0,
+               reg.current.colors + COLREG_BG0, 4) == 0) {
+        
+        drawCanvasFast<indices>(mode);
+        return;
+    }
+#endif
+    
+    drawCanvasPixel<indices>(0, mode, d016, xscroll == 0, true);
     
     // After the first pixel, color register changes show up
     reg.delayed.colors[COLREG_BG0] = reg.current.colors[COLREG_BG0];
@@ -117,9 +156,9 @@ VICII::drawCanvas()
     reg.delayed.colors[COLREG_BG2] = reg.current.colors[COLREG_BG2];
     reg.delayed.colors[COLREG_BG3] = reg.current.colors[COLREG_BG3];
 
-    drawCanvasPixel(1, mode, d016, xscroll == 1, true);
-    drawCanvasPixel(2, mode, d016, xscroll == 2, false);
-    drawCanvasPixel(3, mode, d016, xscroll == 3, false);
+    drawCanvasPixel<indices>(1, mode, d016, xscroll == 1, true);
+    drawCanvasPixel<indices>(2, mode, d016, xscroll == 2, false);
+    drawCanvasPixel<indices>(3, mode, d016, xscroll == 3, false);
 
     // After pixel 4, a change in D016 affects the display mode.
     newD016 = reg.current.ctrl2;
@@ -131,8 +170,8 @@ VICII::drawCanvas()
     oldMode = mode;
     mode = (d011 & 0x60) | (newD016 & 0x10);
     
-    drawCanvasPixel(4, mode, d016, xscroll == 4, oldMode != mode);
-    drawCanvasPixel(5, mode, d016, xscroll == 5, false);
+    drawCanvasPixel<indices>(4, mode, d016, xscroll == 4, oldMode != mode);
+    drawCanvasPixel<indices>(5, mode, d016, xscroll == 5, false);
     
     // In older VICIIs, the zero bits of D011 show up here.
     if (is656x()) {
@@ -141,7 +180,7 @@ VICII::drawCanvas()
         mode = (d011 & 0x60) | (newD016 & 0x10);
     }
 
-    drawCanvasPixel(6, mode, d016, xscroll == 6, oldMode != mode);
+    drawCanvasPixel<indices>(6, mode, d016, xscroll == 6, oldMode != mode);
     
     // Before the last pixel is drawn, a change is D016 is fully detected.
     // If the multicolor bit get set, the mc flip flop is also reset.
@@ -151,11 +190,11 @@ VICII::drawCanvas()
         d016 = newD016;
     }
  
-    drawCanvasPixel(7, mode, d016, xscroll == 7, false);
+    drawCanvasPixel<indices>(7, mode, d016, xscroll == 7, false);
 }
 
 
-void
+template <bool indices> void
 VICII::drawCanvasPixel(u8 pixel,
                        u8 mode,
                        u8 d016,
@@ -242,14 +281,202 @@ VICII::drawCanvasPixel(u8 pixel,
     sr.remainingBits -= 1;
 }
 
+#if VICII_SIMD
+
+template <bool indices> void
+VICII::drawCanvasFast(u8 mode)
+{
+    // Load shift register
+    u32 result = gAccessResult.delayed();
+    u8 data = BYTE0(result);
+    sr.latchedCharacter = BYTE2(result);
+    sr.latchedColor = BYTE1(result);
+    
+    // Load colors
+    loadColors(mode);
+    
+    // In multicolor mode, each pair of bits forms a double-wide pixel
+    bool multicolor = (mode & 0x10) && ((mode & 0x20) || (sr.latchedColor & 0x8));
+    
+    drawCanvasChunk<indices>(data, multicolor);
+    
+    // Leave the sequencer as if all bits had been shifted out one by one
+    sr.data = 0;
+    sr.mcFlop = true;
+    sr.colorbits = multicolor ? (data & 0x03) : (data & 0x01);
+    sr.remainingBits = 0;
+}
+
+/* Bit masks selecting the color bits of each pixel. In single-color mode,
+ * the upper color bit is never set (0x100 is outside the data byte).
+ */
+static const u16 lowerBitSC[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+static const u16 upperBitSC[8] = { 0x100, 0x100, 0x100, 0x100, 0x100, 0x100, 0x100, 0x100 };
+static const u16 lowerBitMC[8] = { 0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01 };
+static const u16 upperBitMC[8] = { 0x80, 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02 };
+
+#if defined(__SSE2__)
+
+// Selects b where mask is set and a elsewhere
+static inline __m128i
+select128(__m128i a, __m128i b, __m128i mask)
+{
+    return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+}
+
+template <bool indices> void
+VICII::drawCanvasChunk(u8 data, bool multicolor)
+{
+    int index = bufferoffset;
+    assert(index + 7 < TEX_WIDTH);
+    
+    const u16 *lower = multicolor ? lowerBitMC : lowerBitSC;
+    const u16 *upper = multicolor ? upperBitMC : upperBitSC;
+    
+    // Compute the color bits of all pixels (one 16-bit lane per pixel)
+    __m128i d = _mm_set1_epi16(data);
+    __m128i lo = _mm_loadu_si128((const __m128i *)lower);
+    __m128i hi = _mm_loadu_si128((const __m128i *)upper);
+    __m128i bit0 = _mm_cmpeq_epi16(_mm_and_si128(d, lo), lo);
+    __m128i bit1 = _mm_cmpeq_epi16(_mm_and_si128(d, hi), hi);
+    
+    // In multicolor mode, only the upper bit selects the foreground
+    __m128i fg = multicolor ? bit1 : bit0;
+    
+    // Write depth values
+    __m128i depth = select128(_mm_set1_epi8(BACKGROUD_LAYER_DEPTH),
+                              _mm_set1_epi8(FOREGROUND_LAYER_DEPTH),
+                              _mm_packs_epi16(fg, fg));
+    _mm_storel_epi64((__m128i *)(zBuffer + index), depth);
+    
+    // Write pixel sources
+    __m128i source = _mm_and_si128(fg, _mm_set1_epi16(0x100));
+    _mm_storeu_si128((__m128i *)(pixelSource + index), source);
+    
+    // In skipped frames, only the collision checks need the pixel data
+    if (skipFrame) return;
+    
+    if (indices) {
+        
+        // Translate the color bits into color indices
+        __m128i c0 = _mm_set1_epi8(col[0]);
+        __m128i c1 = _mm_set1_epi8(col[1]);
+        __m128i c2 = multicolor ? _mm_set1_epi8(col[2]) : c0;
+        __m128i c3 = multicolor ? _mm_set1_epi8(col[3]) : c1;
+        
+        __m128i b0 = _mm_packs_epi16(bit0, bit0);
+        __m128i b1 = _mm_packs_epi16(bit1, bit1);
+        __m128i colors = select128(select128(c0, c1, b0), select128(c2, c3, b0), b1);
+        _mm_storel_epi64((__m128i *)(indexTexturePtr + index), colors);
+        
+    } else {
+        
+        // Translate the color bits into RGBA values
+        __m128i c0 = _mm_set1_epi32(rgbaTable[col[0]]);
+        __m128i c1 = _mm_set1_epi32(rgbaTable[col[1]]);
+        __m128i c2 = multicolor ? _mm_set1_epi32(rgbaTable[col[2]]) : c0;
+        __m128i c3 = multicolor ? _mm_set1_epi32(rgbaTable[col[3]]) : c1;
+        
+        __m128i b0 = _mm_unpacklo_epi16(bit0, bit0);
+        __m128i b1 = _mm_unpacklo_epi16(bit1, bit1);
+        __m128i rgba = select128(select128(c0, c1, b0), select128(c2, c3, b0), b1);
+        _mm_storeu_si128((__m128i *)(emuTexturePtr + index), rgba);
+        
+        b0 = _mm_unpackhi_epi16(bit0, bit0);
+        b1 = _mm_unpackhi_epi16(bit1, bit1);
+        rgba = select128(select128(c0, c1, b0), select128(c2, c3, b0), b1);
+        _mm_storeu_si128((__m128i *)(emuTexturePtr + index + 4), rgba);
+    }
+}
+
+#elif defined(__ARM_NEON)
+
+// Widens a 16-bit lane mask to a 32-bit lane mask
+static inline uint32x4_t
+widen(uint16x4_t mask)
+{
+    return vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u16(mask)));
+}
+
+template <bool indices> void
+VICII::drawCanvasChunk(u8 data, bool multicolor)
+{
+    int index = bufferoffset;
+    assert(index + 7 < TEX_WIDTH);
+    
+    const u16 *lower = multicolor ? lowerBitMC : lowerBitSC;
+    const u16 *upper = multicolor ? upperBitMC : upperBitSC;
+    
+    // Compute the color bits of all pixels (one 16-bit lane per pixel)
+    uint16x8_t d = vdupq_n_u16(data);
+    uint16x8_t bit0 = vtstq_u16(d, vld1q_u16(lower));
+    uint16x8_t bit1 = vtstq_u16(d, vld1q_u16(upper));
+    
+    // In multicolor mode, only the upper bit selects the foreground
+    uint16x8_t fg = multicolor ? bit1 : bit0;
+    
+    // Write depth values
+    uint8x8_t depth = vbsl_u8(vmovn_u16(fg),
+                              vdup_n_u8(FOREGROUND_LAYER_DEPTH),
+                              vdup_n_u8(BACKGROUD_LAYER_DEPTH));
+    vst1_u8(zBuffer + index, depth);
+    
+    // Write pixel sources
+    vst1q_u16(pixelSource + index, vandq_u16(fg, vdupq_n_u16(0x100)));
+    
+    // In skipped frames, only the collision checks need the pixel data
+    if (skipFrame) return;
+    
+    if (indices) {
+        
+        // Translate the color bits into color indices
+        uint8x8_t c0 = vdup_n_u8(col[0]);
+        uint8x8_t c1 = vdup_n_u8(col[1]);
+        uint8x8_t c2 = multicolor ? vdup_n_u8(col[2]) : c0;
+        uint8x8_t c3 = multicolor ? vdup_n_u8(col[3]) : c1;
+        
+        uint8x8_t b0 = vmovn_u16(bit0);
+        uint8x8_t b1 = vmovn_u16(bit1);
+        vst1_u8(indexTexturePtr + index,
+                vbsl_u8(b1, vbsl_u8(b0, c3, c2), vbsl_u8(b0, c1, c0)));
+        
+    } else {
+        
+        // Translate the color bits into RGBA values
+        uint32x4_t c0 = vdupq_n_u32(rgbaTable[col[0]]);
+        uint32x4_t c1 = vdupq_n_u32(rgbaTable[col[1]]);
+        uint32x4_t c2 = multicolor ? vdupq_n_u32(rgbaTable[col[2]]) : c0;
+        uint32x4_t c3 = multicolor ? vdupq_n_u32(rgbaTable[col[3]]) : c1;
+        
+        uint32x4_t b0 = widen(vget_low_u16(bit0));
+        uint32x4_t b1 = widen(vget_low_u16(bit1));
+        uint32x4_t rgba = vbslq_u32(b1, vbslq_u32(b0, c3, c2), vbslq_u32(b0, c1, c0));
+        vst1q_u32((uint32_t *)(emuTexturePtr + index), rgba);
+        
+        b0 = widen(vget_high_u16(bit0));
+        b1 = widen(vget_high_u16(bit1));
+        rgba = vbslq_u32(b1, vbslq_u32(b0, c3, c2), vbslq_u32(b0, c1, c0));
+        vst1q_u32((uint32_t *)(emuTexturePtr + index + 4), rgba);
+    }
+}
+
+#endif
+#endif
+
 void
 VICII::drawSprites()
+{
+    if (renderIndices) _drawSprites<true>(); else _drawSprites<false>();
+}
+
+template <bool indices> void
+VICII::_drawSprites()
 {
     u8 firstDMA = isFirstDMAcycle;
     u8 secondDMA = isSecondDMAcycle;
     
     // Pixel 0
-    drawSpritePixel(0, spriteDisplayDelayed, secondDMA);
+    drawSpritePixel<indices>(0, spriteDisplayDelayed, secondDMA);
     
     // After the first pixel, color register changes show up
     reg.delayed.colors[COLREG_SPR_EX1] = reg.current.colors[COLREG_SPR_EX1];
@@ -259,20 +486,20 @@ VICII::drawSprites()
     }
     
     // Pixel 1, Pixel 2, Pixel 3
-    drawSpritePixel(1, spriteDisplayDelayed, secondDMA);
+    drawSpritePixel<indices>(1, spriteDisplayDelayed, secondDMA);
     
     // Stop shift register on the second DMA cycle
     spriteSrActive &= ~secondDMA;
     
-    drawSpritePixel(2, spriteDisplayDelayed, secondDMA);
-    drawSpritePixel(3, spriteDisplayDelayed, firstDMA | secondDMA);
+    drawSpritePixel<indices>(2, spriteDisplayDelayed, secondDMA);
+    drawSpritePixel<indices>(3, spriteDisplayDelayed, firstDMA | secondDMA);
     
     // If a shift register is loaded, the new data appears here.
     updateSpriteShiftRegisters();
 
     // Pixel 4, Pixel 5
-    drawSpritePixel(4, spriteDisplay, firstDMA | secondDMA);
-    drawSpritePixel(5, spriteDisplay, firstDMA | secondDMA);
+    drawSpritePixel<indices>(4, spriteDisplay, firstDMA | secondDMA);
+    drawSpritePixel<indices>(5, spriteDisplay, firstDMA | secondDMA);
     
     // Changes of the X expansion bits and the priority bits show up here
     reg.delayed.sprExpandX = reg.current.sprExpandX;
@@ -296,7 +523,7 @@ VICII::drawSprites()
     }
     
     // Pixel 6
-    drawSpritePixel(6, spriteDisplay, firstDMA | secondDMA);
+    drawSpritePixel<indices>(6, spriteDisplay, firstDMA | secondDMA);
     
     // Update multicolor bits if an old VICII is emulated
     if (toggle && is656x()) {
@@ -309,7 +536,7 @@ VICII::drawSprites()
     }
     
     // Pixel 7
-    drawSpritePixel(7, spriteDisplay, firstDMA);
+    drawSpritePixel<indices>(7, spriteDisplay, firstDMA);
     
     // Check for collisions
     for (unsigned i = 0; i < 8; i++) {
@@ -342,7 +569,7 @@ VICII::drawSprites()
     }
 }
 
-void
+template <bool indices> void
 VICII::drawSpritePixel(unsigned pixel,
                      u8 enableBits,
                      u8 freezeBits)
@@ -414,15 +641,15 @@ VICII::drawSpritePixel(unsigned pixel,
             switch (spriteSr[sprite].colBits) {
                     
                 case 0x01:
-                    setSpritePixel(sprite, pixel, reg.delayed.colors[COLREG_SPR_EX1]);
+                    setSpritePixel<indices>(sprite, pixel, reg.delayed.colors[COLREG_SPR_EX1]);
                     break;
                     
                 case 0x02:
-                    setSpritePixel(sprite, pixel, reg.delayed.colors[COLREG_SPR0 + sprite]);
+                    setSpritePixel<indices>(sprite, pixel, reg.delayed.colors[COLREG_SPR0 + sprite]);
                     break;
                     
                 case 0x03:
-                    setSpritePixel(sprite, pixel, reg.delayed.colors[COLREG_SPR_EX2]);
+                    setSpritePixel<indices>(sprite, pixel, reg.delayed.colors[COLREG_SPR_EX2]);
                     break;
             }
         }
@@ -502,7 +729,7 @@ VICII::loadColors(u8 mode)
 // Low level drawing (pixel buffer access)
 //
 
-void
+template <bool indices> void
 VICII::setSpritePixel(unsigned sprite, unsigned pixel, u8 color)
 {
     u8 depth = spriteDepth(sprite);
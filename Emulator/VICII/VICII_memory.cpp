@@ -630,7 +630,7 @@ VICII::memAccess(u16 addr)
             return mem.ram[addrBus];
             
         case M_CHAR:
-            return mem.rom[0xC000 + addr];
+            return mem.charRom[addr & 0x0FFF];
 
         case M_CRTHI:
             return expansionport.peek(addrBus | 0xF000);
@@ -673,7 +673,7 @@ VICII::memSpyAccess(u16 addr)
     } else {
         
         if (isCharRomAddr(addr)) {
-            result = mem.rom[0xC000 + addr];
+            result = mem.charRom[addr & 0x0FFF];
         } else {
             result = mem.ram[addrBus];
         }
@@ -0,0 +1,460 @@
+// -----------------------------------------------------------------------------
+// This file is part of VirtualC64
+//
+// Copyright (C) Dirk W. Hoffmann. www.dirkwhoffmann.de
+// Licensed under the GNU General Public License v2
+//
+// See https://www.gnu.org for license information
+// -----------------------------------------------------------------------------
+
+/* Headless batch runner. This executable drives the core emulator without any
+ * GUI. It powers on a C64 with the specified Roms, optionally flashes a file
+ * into memory, and emulates a given number of frames in warp mode. At exit,
+ * the measured throughput is printed to the console.
+ *
+ *     Usage: headless -basic <path> -char <path> -kernal <path>
+ *                     [-vc1541 <path>] [-boot <frames>] [-frames <frames>]
+ *                     [-fastdrive] [-cpu] [-trace <path>] [-rewind <KB>]
+ *                     [-runahead <frames>] [-snapshots <count>]
+ *                     [-farm <instances>] [-indexed] [-frameskip <frames>]
+ *                     [-novideo] [file]
+ *
+ * The optional file can be a PRG, P00, T64, or D64 file (the first item is
+ * flashed into memory) or a CRT file (the cartridge is attached). Before the
+ * file is flashed, the C64 is emulated for the number of boot frames to give
+ * the Kernal a chance to finish its initialization.
+ *
+ * Option -fastdrive enables the fast CPU mode of the connected drive.
+ *
+ * Option -indexed selects the indexed texture format. VICII writes color
+ * indices instead of RGBA values. The indices are never converted because no
+ * GUI requests the texture.
+ *
+ * Option -frameskip skips the specified number of frames after each drawn
+ * frame. In skipped frames, VICII runs all of its logic including the
+ * collision checks, but doesn't write any pixels.
+ *
+ * Option -novideo puts VICII into headless mode. No texture buffers are
+ * allocated and no frame is drawn. After the measured section, a single frame
+ * is requested to check that capturing a frame on demand works.
+ *
+ * If the emulator is compiled with C64_PROFILING=1, the time spent in each
+ * component is printed, too.
+ *
+ * Option -trace records all instructions executed in the measured section to
+ * the specified trace file. Comparing the throughput with and without this
+ * option reveals the tracing overhead.
+ *
+ * Option -rewind enables the rewind buffer with the specified budget. After
+ * the measured section, the emulator is rewound by half of the recorded
+ * frames. The frame latency includes the time needed to record the frames.
+ *
+ * Option -runahead emulates each frame in run-ahead mode. The frame latency
+ * includes the time needed to run ahead and to restore the emulator state.
+ *
+ * Option -snapshots takes, compresses, and restores the specified number of
+ * snapshots after the measured section and prints the average latency of each
+ * operation. Restoring a snapshot includes decompressing it.
+ *
+ * Option -farm runs the specified number of instances in a C64Farm instead of
+ * running a single instance. The benchmark is repeated with 1, 2, 4, ...
+ * workers up to the number of cores. For each run, the aggregated throughput
+ * and the speedup over a single worker are printed. Afterwards, the counters
+ * of each instance are printed for the run with all workers.
+ *
+ * If option -cpu is given, only the C64 CPU is clocked in the measured
+ * section. It executes as many cycles as the specified number of frames
+ * comprises. This mode benchmarks the micro instruction dispatcher. To
+ * compare the computed goto dispatcher with the switch statement, run the
+ * same workload with two builds, one of them compiled with
+ * CPU_COMPUTED_GOTO=1.
+ *
+ * If the C64 CPU or a drive CPU jams, the measured section ends early. The
+ * report covers the frames emulated so far and the runner exits with 1.
+ */
+
+#include "C64Farm.h"
+#include <algorithm>
+
+// Number of frames to emulate (default)
+static const long defaultFrames = 5000;
+
+// Number of frames to emulate before a file is flashed (default)
+static const long defaultBootFrames = 150;
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s -basic <path> -char <path> -kernal <path>\n", name);
+    fprintf(stderr, "          [-vc1541 <path>] [-boot <frames>] [-frames <frames>]\n");
+    fprintf(stderr, "          [-fastdrive] [-cpu] [-trace <path>] [-rewind <KB>]\n");
+    fprintf(stderr, "          [-runahead <frames>] [-snapshots <count>]\n");
+    fprintf(stderr, "          [-farm <instances>] [-indexed] [-frameskip <frames>]\n");
+    fprintf(stderr, "          [-novideo] [file]\n");
+}
+
+static bool
+flashFile(C64 &c64, const char *path)
+{
+    if (CRTFile::isCRTFile(path)) {
+
+        CRTFile *crt = CRTFile::makeWithFile(path);
+        return crt && c64.expansionport.attachCartridgeAndReset(crt);
+    }
+
+    if (AnyArchive *archive = AnyArchive::makeWithFile(path)) {
+
+        bool result = archive->numberOfItems() > 0 && c64.flash(archive, 0);
+        delete archive;
+        return result;
+    }
+
+    return false;
+}
+
+static u64
+percentile(vector<u64> &sorted, double p)
+{
+    if (sorted.empty()) return 0;
+
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[MIN(index, sorted.size() - 1)];
+}
+
+static C64 *
+createC64(const char *basic, const char *character, const char *kernal,
+          const char *vc1541, bool fastDrive, bool indexed, long frameSkip,
+          bool noVideo, const char *file, long bootFrames)
+{
+    C64 *c64 = new C64();
+    c64->configure(C64_PAL);
+    if (indexed) c64->configure(OPT_INDEXED_TEXTURE, true);
+    if (frameSkip) c64->configure(OPT_FRAME_SKIP, frameSkip);
+    if (noVideo) c64->configure(OPT_VIC_HEADLESS, true);
+
+    // Install Roms
+    if (!c64->loadRomFromFile(ROM_BASIC, basic) ||
+        !c64->loadRomFromFile(ROM_CHAR, character) ||
+        !c64->loadRomFromFile(ROM_KERNAL, kernal) ||
+        (vc1541 && !c64->loadRomFromFile(ROM_VC1541, vc1541))) {
+
+        fprintf(stderr, "Failed to install Roms\n");
+        delete c64;
+        return NULL;
+    }
+    if (vc1541) c64->configure(DRIVE8, OPT_DRIVE_CONNECT, true);
+    if (vc1541 && fastDrive) c64->configure(DRIVE8, OPT_DRIVE_FAST_CPU, true);
+
+    // Power on in warp mode. No emulator thread is launched. Instead, frames
+    // are emulated directly by calling executeOneFrame().
+    c64->powerOn();
+    if (!c64->isPoweredOn()) {
+
+        fprintf(stderr, "Failed to power on the emulator\n");
+        delete c64;
+        return NULL;
+    }
+    c64->setWarp(true);
+
+    // Flash the specified file
+    if (file) {
+
+        for (long i = 0; i < bootFrames; i++) c64->executeOneFrame();
+
+        if (!flashFile(*c64, file)) {
+
+            fprintf(stderr, "Failed to flash %s\n", file);
+            delete c64;
+            return NULL;
+        }
+    }
+
+    return c64;
+}
+
+static int
+runFarm(long instances, long frames, const char *basic, const char *character,
+        const char *kernal, const char *vc1541, bool fastDrive, bool indexed,
+        long frameSkip, bool noVideo, const char *file, long bootFrames)
+{
+    long cores = C64Farm::numCores();
+    double baseline = 0.0;
+
+    printf("Instances         : %ld\n", instances);
+    printf("Frames / instance : %ld\n", frames);
+    printf("Host cores        : %ld\n", cores);
+
+    for (long workers = 1;; workers = MIN(2 * workers, cores)) {
+
+        C64Farm *farm = new C64Farm(workers);
+
+        for (long i = 0; i < instances; i++) {
+
+            C64 *c64 = createC64(basic, character, kernal, vc1541, fastDrive,
+                                 indexed, frameSkip, noVideo, file, bootFrames);
+            if (!c64) { delete farm; return 1; }
+            farm->add(c64);
+        }
+
+        u64 start = monotonicNanos();
+        farm->run(frames);
+        double seconds = (monotonicNanos() - start) / 1000000000.0;
+
+        u64 total = 0;
+        for (long i = 0; i < instances; i++) total += farm->getInfo(i).frames;
+        double fps = seconds > 0 ? total / seconds : 0.0;
+        if (workers == 1) baseline = fps;
+
+        printf("Workers %3ld       : %.2f fps (%.2fx)\n", farm->numWorkers(),
+               fps, baseline > 0 ? fps / baseline : 0.0);
+
+        // Print the counters of all instances in the final run
+        if (workers == cores) {
+
+            for (long i = 0; i < instances; i++) {
+
+                FarmInstanceInfo info = farm->getInfo(i);
+                printf("Instance %3ld      : %llu frames, %.2f fps, %llu slices "
+                       "(%llu stolen), worker %ld%s\n",
+                       i, (unsigned long long)info.frames, info.fps,
+                       (unsigned long long)info.slices, (unsigned long long)info.steals,
+                       info.worker, info.halted ? ", halted" : "");
+            }
+            delete farm;
+            break;
+        }
+        delete farm;
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *basic = NULL, *character = NULL, *kernal = NULL, *vc1541 = NULL;
+    const char *file = NULL, *trace = NULL;
+    long frames = defaultFrames;
+    long bootFrames = defaultBootFrames;
+    long rewindBudget = 0;
+    long runAhead = 0;
+    long snapshots = 0;
+    long farm = 0;
+    long frameSkip = 0;
+    bool fastDrive = false;
+    bool indexed = false;
+    bool noVideo = false;
+    bool cpuOnly = false;
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "-basic") == 0 && hasValue) {
+            basic = argv[++i];
+        } else if (strcmp(argv[i], "-char") == 0 && hasValue) {
+            character = argv[++i];
+        } else if (strcmp(argv[i], "-kernal") == 0 && hasValue) {
+            kernal = argv[++i];
+        } else if (strcmp(argv[i], "-vc1541") == 0 && hasValue) {
+            vc1541 = argv[++i];
+        } else if (strcmp(argv[i], "-frames") == 0 && hasValue) {
+            frames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-boot") == 0 && hasValue) {
+            bootFrames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-trace") == 0 && hasValue) {
+            trace = argv[++i];
+        } else if (strcmp(argv[i], "-rewind") == 0 && hasValue) {
+            rewindBudget = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-runahead") == 0 && hasValue) {
+            runAhead = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-snapshots") == 0 && hasValue) {
+            snapshots = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-farm") == 0 && hasValue) {
+            farm = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-frameskip") == 0 && hasValue) {
+            frameSkip = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-fastdrive") == 0) {
+            fastDrive = true;
+        } else if (strcmp(argv[i], "-indexed") == 0) {
+            indexed = true;
+        } else if (strcmp(argv[i], "-novideo") == 0) {
+            noVideo = true;
+        } else if (strcmp(argv[i], "-cpu") == 0) {
+            cpuOnly = true;
+        } else if (argv[i][0] != '-' && file == NULL) {
+            file = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!basic || !character || !kernal || frames <= 0 || bootFrames < 0 ||
+        rewindBudget < 0 || runAhead < 0 || snapshots < 0 || farm < 0 ||
+        frameSkip < 0 || frameSkip > 255) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (farm) {
+        return runFarm(farm, frames, basic, character, kernal, vc1541,
+                       fastDrive, indexed, frameSkip, noVideo, file, bootFrames);
+    }
+
+    C64 *c64 = createC64(basic, character, kernal, vc1541, fastDrive,
+                         indexed, frameSkip, noVideo, file, bootFrames);
+    if (!c64) return 1;
+
+    // Start recording a trace
+    if (trace && !c64->cpu.debugger.startRecording(trace)) {
+
+        fprintf(stderr, "Failed to create %s\n", trace);
+        delete c64;
+        return 1;
+    }
+
+    // Enable the rewind buffer
+    if (rewindBudget) c64->setRewindBudget(rewindBudget * 1024);
+    c64->setRunAhead(runAhead);
+
+    // Run the benchmark
+    c64->clearProfileInfo();
+    vector<u64> latency;
+    latency.reserve(frames);
+
+    u64 startCycle = c64->cpu.cycle;
+    u64 startFrame = c64->frame;
+    long cyclesPerFrame = c64->vic.getCyclesPerFrame();
+    u64 start = monotonicNanos();
+
+    bool jammed = false;
+    for (long i = 0; i < frames; i++) {
+
+        u64 frameStart = monotonicNanos();
+        if (cpuOnly) {
+            for (long j = 0; j < cyclesPerFrame; j++) {
+                c64->cpu.cycle++;
+                if (trace) c64->cpu.executeOneCycle<true>();
+                else c64->cpu.executeOneCycle<false>();
+            }
+        } else if (runAhead) {
+            c64->executeOneFrameAhead();
+        } else {
+            c64->executeOneFrame();
+        }
+        latency.push_back(monotonicNanos() - frameStart);
+
+        // Stop if the C64 CPU or a drive CPU has jammed
+        if (c64->getControlFlags() & RL_CPU_JAMMED) { jammed = true; break; }
+    }
+
+    u64 elapsed = monotonicNanos() - start;
+    if (trace) c64->cpu.debugger.stopRecording();
+    u64 cycles = c64->cpu.cycle - startCycle;
+    u64 emulatedFrames = cpuOnly ? latency.size() : c64->frame - startFrame;
+    double seconds = (double)elapsed / 1000000000.0;
+
+    // Rewind by half of the recorded frames
+    long rewindable = c64->rewindableFrames();
+    u64 rewindBytes = c64->rewindBuffer.usedBytes();
+    u64 rewindStart = monotonicNanos();
+    bool rewound = rewindBudget && c64->rewind(rewindable / 2);
+    u64 rewindTime = monotonicNanos() - rewindStart;
+
+    // Take, compress, and restore snapshots
+    u64 saveTime = 0, compressTime = 0, loadTime = 0;
+    size_t snapshotSize = 0, compressedSize = 0;
+    for (long i = 0; i < snapshots; i++) {
+
+        u64 t0 = monotonicNanos();
+        Snapshot *snapshot = Snapshot::makeWithC64(c64);
+        u64 t1 = monotonicNanos();
+        snapshotSize = snapshot->getSize();
+        snapshot->compress();
+        u64 t2 = monotonicNanos();
+        compressedSize = snapshot->getSize();
+        c64->loadFromSnapshot(snapshot);
+        u64 t3 = monotonicNanos();
+
+        saveTime += t1 - t0;
+        compressTime += t2 - t1;
+        loadTime += t3 - t2;
+        delete snapshot;
+    }
+
+    // Capture a single frame on demand
+    long captureFrames = 0;
+    if (noVideo && !cpuOnly) {
+
+        c64->vic.requestFrame();
+        while (c64->vic.isFrameRequested() && captureFrames < 3) {
+            c64->executeOneFrame();
+            captureFrames++;
+        }
+    }
+
+    // Print results
+    std::sort(latency.begin(), latency.end());
+
+    printf("Emulated devices  : %s\n", cpuOnly ? "CPU only" : "All");
+    printf("CPU dispatch      : %s\n", CPU_COMPUTED_GOTO ? "Computed goto" : "Switch");
+    printf("Texture format    : %s\n", noVideo ? "None (headless)" :
+           c64->vic.rendersIndices() ? "Indexed" : "RGBA");
+    printf("Frame skip        : %ld\n", c64->getConfigItem(OPT_FRAME_SKIP));
+    if (runAhead) printf("Run-ahead         : %ld frames\n", runAhead);
+    if (noVideo && !cpuOnly) {
+        c64->vic.updateStableFrame();
+        if (c64->vic.stableEmuTexture(false) && !c64->vic.isFrameRequested()) {
+            printf("Captured frame    : %llu (after %ld frames)\n",
+                   (unsigned long long)c64->vic.stableFrameNr(), captureFrames);
+        } else {
+            printf("Captured frame    : failed\n");
+        }
+    }
+    if (trace) printf("Recorded trace    : %llu instructions\n",
+                      (unsigned long long)c64->cpu.debugger.recorder.getCount());
+    printf("Emulated frames   : %llu\n", (unsigned long long)emulatedFrames);
+    printf("Emulated cycles   : %llu\n", (unsigned long long)cycles);
+    printf("Elapsed time      : %.3f sec\n", seconds);
+    printf("Frames per second : %.2f\n", seconds > 0 ? emulatedFrames / seconds : 0.0);
+    printf("Emulated MHz      : %.3f\n", seconds > 0 ? cycles / seconds / 1000000.0 : 0.0);
+    printf("Frame latency p50 : %.3f msec\n", percentile(latency, 0.50) / 1000000.0);
+    printf("Frame latency p90 : %.3f msec\n", percentile(latency, 0.90) / 1000000.0);
+    printf("Frame latency p99 : %.3f msec\n", percentile(latency, 0.99) / 1000000.0);
+    printf("Frame latency max : %.3f msec\n", percentile(latency, 1.00) / 1000000.0);
+    if (rewindBudget) {
+        printf("Rewindable frames : %ld (%llu bytes)\n",
+               rewindable, (unsigned long long)rewindBytes);
+        printf("Rewind %5ld frames: %s (%.3f msec)\n", rewindable / 2,
+               rewound ? "Done" : "Failed", rewindTime / 1000000.0);
+    }
+    if (snapshots) {
+        printf("Snapshot size     : %zu bytes (%zu compressed)\n", snapshotSize, compressedSize);
+        printf("Snapshot save     : %.3f msec\n", saveTime / snapshots / 1000000.0);
+        printf("Snapshot compress : %.3f msec\n", compressTime / snapshots / 1000000.0);
+        printf("Snapshot load     : %.3f msec\n", loadTime / snapshots / 1000000.0);
+    }
+    if (jammed) {
+        if (c64->cpu.isJammed()) {
+            fprintf(stderr, "CPU jammed at %04X\n", c64->cpu.getPC0());
+        } else {
+            fprintf(stderr, "Drive CPU jammed\n");
+        }
+    }
+
+#if C64_PROFILING
+    ProfileInfo profile = c64->getProfileInfo();
+    u64 total = 0;
+    for (int i = 0; i < PROF_COUNT; i++) total += profile.accumulated[i];
+
+    for (int i = 0; i < PROF_COUNT; i++) {
+        printf("Profile %-12s: %6.2f %%\n", profiledComponentName((ProfiledComponent)i),
+               total ? 100.0 * profile.accumulated[i] / total : 0.0);
+    }
+#endif
+
+    delete c64;
+    return jammed ? 1 : 0;
+}